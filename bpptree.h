@@ -997,7 +997,7 @@ public:
         insert(begin, end);
     }
     //copy
-    b_plus_plus_tree(b_plus_plus_tree const &other) : root_(other.get_comparator_(), other.get_node_allocator_())
+    b_plus_plus_tree(b_plus_plus_tree const &other) : root_(other.get_comparator_(), std::allocator_traits<node_allocator_t>::select_on_container_copy_construction(other.get_node_allocator_()))
     {
         insert(other.begin(), other.end());
     }
@@ -1038,7 +1038,10 @@ public:
         }
         clear();
         get_comparator_() = other.get_comparator_();
-        get_node_allocator_() = other.get_node_allocator_();
+        if(std::allocator_traits<node_allocator_t>::propagate_on_container_copy_assignment::value)
+        {
+            get_node_allocator_() = other.get_node_allocator_();
+        }
         insert(other.begin(), other.end());
         return *this;
     }
@@ -1065,6 +1068,11 @@ public:
         return root_;
     }
 
+    key_compare key_comp() const
+    {
+        return get_comparator_();
+    }
+
     void swap(b_plus_plus_tree &other)
     {
         std::swap(root_, other.root_);
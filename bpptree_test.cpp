@@ -3,6 +3,7 @@
 
 #include "bpptree_map.h"
 #include "bpptree_set.h"
+#include "eytzinger_tree.h"
 
 #include <chrono>
 #include <iostream>
@@ -498,6 +499,25 @@ int main()
         rb.clear();
     }();
 
+    [&]()
+    {
+        bpptree_multimap<int, int> bp;
+        for(int i = 0; i < 5000; ++i)
+        {
+            bp.emplace(rand() % 3000, i);
+        }
+        auto frozen = freeze(bp);
+        assert(frozen.size() == bp.size() && std::equal(frozen.begin(), frozen.end(), bp.begin(), bp.end()));
+        for(int key = -1; key <= 3000; ++key)
+        {
+            assert(frozen.rank(key) == bp.rank(bp.lower_bound(key)) && frozen.count(key) == bp.count(key));
+            assert((frozen.find(key) == frozen.end()) == (bp.find(key) == bp.end()));
+        }
+        bpptree_set<int> set = {3, 1, 2};
+        auto frozen_set = freeze(set);
+        assert(frozen_set.rank(2) == 1 && frozen_set.at(2) == frozen_set.end() - 1);
+    }();
+
     auto t = std::chrono::high_resolution_clock::now;
     std::mt19937 mt(0);
     auto mtr = std::uniform_int_distribution<int>(-10000000, 0);
@@ -1,14 +1,25 @@
 ﻿#pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <algorithm>
 #include <utility>
+#include <tuple>
 #include <memory>
 #include <cstring>
 #include <stdexcept>
 #include <functional>
 #include <cmath>
+#include <limits>
 #include <type_traits>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#endif
 
 
 namespace contiguous_hash_detail
@@ -58,8 +69,242 @@ namespace contiguous_hash_detail
             destroy_one(move_begin, move_assign_tag());
         }
     }
+
+    inline void prefetch(void const *address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _mm_prefetch(static_cast<char const *>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
+    }
+
+    //512 bit blocks, a query touches one cache line, 6 bits are set per key
+    class blocked_bloom_t
+    {
+    public:
+        static std::size_t const bits_per_key = 10;
+
+        blocked_bloom_t() : block_count_(0)
+        {
+        }
+        //sized for count keys, all bits cleared
+        void reset(std::size_t count)
+        {
+            block_count_ = (count * bits_per_key + 511) / 512;
+            word_.assign(block_count_ == 0 ? 0 : block_count_ * 8 + 7, 0);
+        }
+        void clear()
+        {
+            std::fill(word_.begin(), word_.end(), 0);
+        }
+        void insert(std::uint64_t hash)
+        {
+            if(block_count_ == 0)
+            {
+                return;
+            }
+            std::uint64_t bits;
+            std::uint64_t *block = block_(hash, bits);
+            for(int i = 0; i < 6; ++i, bits >>= 9)
+            {
+                block[(bits >> 6) & 7] |= std::uint64_t(1) << (bits & 63);
+            }
+        }
+        //false means absent, an unsized filter knows nothing
+        bool may_contain(std::uint64_t hash) const
+        {
+            if(block_count_ == 0)
+            {
+                return true;
+            }
+            std::uint64_t bits;
+            std::uint64_t const *block = const_cast<blocked_bloom_t *>(this)->block_(hash, bits);
+            for(int i = 0; i < 6; ++i, bits >>= 9)
+            {
+                if(!(block[(bits >> 6) & 7] & (std::uint64_t(1) << (bits & 63))))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        std::size_t block_count() const
+        {
+            return block_count_;
+        }
+
+    private:
+        std::uint64_t *block_(std::uint64_t hash, std::uint64_t &bits)
+        {
+            std::uint64_t mix = hash * 0x9E3779B97F4A7C15ull;
+            bits = (mix ^ (mix >> 29)) * 0xBF58476D1CE4E5B9ull;
+            std::uint64_t *base = reinterpret_cast<std::uint64_t *>((reinterpret_cast<std::uintptr_t>(word_.data()) + 63) & ~std::uintptr_t(63));
+            return base + ((mix >> 32) * block_count_ >> 32) * 8;
+        }
+        std::size_t block_count_;
+        std::vector<std::uint64_t> word_;
+    };
+    //config_t without bloom_type
+    class bloom_none_t
+    {
+    public:
+        void reset(std::size_t)
+        {
+        }
+        void clear()
+        {
+        }
+        void insert(std::uint64_t)
+        {
+        }
+        bool may_contain(std::uint64_t) const
+        {
+            return true;
+        }
+    };
+    //config_t::bloom_type is std::true_type to keep a filter in front of the buckets
+    template<class config_t, class = void> struct bloom_select_t : public std::false_type
+    {
+        typedef bloom_none_t type;
+    };
+    template<class config_t> struct bloom_select_t<config_t, typename std::enable_if<config_t::bloom_type::value>::type> : public std::true_type
+    {
+        typedef blocked_bloom_t type;
+    };
+
+    //config_t::ordered_type is std::true_type to append every insert at the end, free slots are reused only by compaction
+    template<class config_t, class = void> struct ordered_select_t : public std::false_type
+    {
+    };
+    template<class config_t> struct ordered_select_t<config_t, typename std::enable_if<config_t::ordered_type::value>::type> : public std::true_type
+    {
+    };
+
+    //once the used slots exceed compact_proportion(capacity) times the size, the next insert runs shrink_to_fit
+    //erase never compacts, the default is 4, config_t::compact_proportion <= 1 turns it off
+    template<class config_t, class = void> struct compact_select_t
+    {
+        static float proportion(std::size_t)
+        {
+            return 4;
+        }
+    };
+    template<class config_t> struct compact_select_t<config_t, decltype(void(config_t::compact_proportion(std::size_t())))>
+    {
+        static float proportion(std::size_t capacity)
+        {
+            return config_t::compact_proportion(capacity);
+        }
+    };
+
+    //allocator_t::reallocate(address, old_count, new_count) returns nullptr when the block can not be resized
+    template<class allocator_t, class = void> struct has_reallocate : public std::false_type
+    {
+    };
+    template<class allocator_t> struct has_reallocate<allocator_t, decltype(void(std::declval<allocator_t &>().reallocate(std::declval<typename allocator_t::value_type *>(), std::size_t(), std::size_t())))> : public std::true_type
+    {
+    };
+    template<class allocator_t> typename allocator_t::value_type *try_reallocate(allocator_t &alloc, typename allocator_t::value_type *address, std::size_t old_count, std::size_t new_count, std::true_type)
+    {
+        return alloc.reallocate(address, old_count, new_count);
+    }
+    template<class allocator_t> typename allocator_t::value_type *try_reallocate(allocator_t &, typename allocator_t::value_type *, std::size_t, std::size_t, std::false_type)
+    {
+        return nullptr;
+    }
+
+    //config_t::status_type is std::true_type to count probes of real lookups, counters are relaxed atomics so const readers may run concurrently
+    template<class config_t, class = void> struct status_select_t
+    {
+        typedef std::false_type type;
+    };
+    template<class config_t> struct status_select_t<config_t, typename std::enable_if<config_t::status_type::value>::type>
+    {
+        typedef std::true_type type;
+    };
+
+    //run proc(0) ... proc(thread_count - 1) in parallel, the calling thread takes part
+    //if no more threads can be started the rest runs on the calling thread, first exception is rethrown
+    template<class proc_t> void parallel_for(std::size_t thread_count, proc_t const &proc)
+    {
+        if(thread_count <= 1)
+        {
+            proc(std::size_t(0));
+            return;
+        }
+        std::vector<std::exception_ptr> error(thread_count);
+        auto run = [&proc, &error](std::size_t part)
+        {
+            try
+            {
+                proc(part);
+            }
+            catch(...)
+            {
+                error[part] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> thread;
+        std::size_t started = 1;
+        try
+        {
+            thread.reserve(thread_count - 1);
+            for(; started < thread_count; ++started)
+            {
+                thread.emplace_back(run, started);
+            }
+        }
+        catch(...)
+        {
+        }
+        run(0);
+        for(std::size_t part = started; part < thread_count; ++part)
+        {
+            run(part);
+        }
+        for(auto &item : thread)
+        {
+            item.join();
+        }
+        for(auto &item : error)
+        {
+            if(item)
+            {
+                std::rethrow_exception(item);
+            }
+        }
+    }
+
+    //file layout of contiguous_hash::save, read back by contiguous_hash_view
+    struct image_header_t
+    {
+        char magic[8];
+        std::uint32_t offset_size;
+        std::uint32_t index_size;
+        std::uint32_t value_size;
+        std::uint32_t value_align;
+        std::uint64_t bucket_count;
+        std::uint64_t size;
+        std::uint64_t free_count;
+        std::uint64_t bucket_position;
+        std::uint64_t index_position;
+        std::uint64_t value_position;
+        std::uint64_t file_size;
+    };
+    static char const image_magic[8] = {'z', 'c', 'h', 'a', 's', 'h', '\0', '\1'};
+    static std::uint64_t const image_align = 64;
+
+    inline std::uint64_t image_align_up(std::uint64_t position)
+    {
+        return (position + image_align - 1) & ~(image_align - 1);
+    }
 }
 
+template<class config_t> class contiguous_hash_view;
+
 template<class config_t>
 class contiguous_hash
 {
@@ -81,7 +326,29 @@ public:
 
     static constexpr offset_type offset_empty = offset_type(-1);
 
+    //snapshot by probe_stats(), chain counts and averages over the current content
+    struct probe_stats_t
+    {
+        size_type size;
+        size_type slot_count;
+        size_type free_count;
+        size_type capacity;
+        size_type bucket_count;
+        float load_factor;
+        //chain_histogram[n] is the count of buckets holding n elements
+        std::vector<size_type> chain_histogram;
+        //chain nodes visited and key_equal calls of a find for a stored element
+        double success_probe;
+        double success_compare;
+        //chain nodes visited by a find for a missing key, every bucket equally likely
+        double fail_probe;
+        //key_equal calls of a find for a missing key with the hash of a stored element, 0 without full hash collisions
+        double fail_compare;
+    };
+
 protected:
+    template<class> friend class contiguous_hash_view;
+
     struct hash_t
     {
         hash_value_type hash;
@@ -141,7 +408,79 @@ protected:
     typedef typename allocator_type::template rebind<offset_type>::other bucket_allocator_t;
     typedef typename allocator_type::template rebind<index_t>::other index_allocator_t;
     typedef typename allocator_type::template rebind<value_t>::other value_allocator_t;
-    struct root_t : public hasher, public key_equal, public bucket_allocator_t, public index_allocator_t, public value_allocator_t
+    typedef contiguous_hash_detail::bloom_select_t<config_t> bloom_select_t;
+    typedef typename bloom_select_t::type bloom_t;
+    typedef contiguous_hash_detail::ordered_select_t<config_t> ordered_select_t;
+    typedef contiguous_hash_detail::compact_select_t<config_t> compact_select_t;
+    template<class, class> struct status_select_t
+    {
+        status_select_t() : lookup_count(), hit_count(), probe_count(), compare_count()
+        {
+        }
+        //find, erase, at and unique insert each count one lookup
+        size_type lookup_count;
+        size_type hit_count;
+        //chain nodes visited
+        size_type probe_count;
+        //key_equal calls
+        size_type compare_count;
+    };
+    template<class unused_t> struct status_select_t<std::false_type, unused_t>
+    {
+        status_select_t()
+        {
+        }
+    };
+    typedef status_select_t<typename contiguous_hash_detail::status_select_t<config_t>::type, void> status_t;
+    //the counters live in root_ and are bumped from const lookups
+    template<class, class> struct status_control_select_t
+    {
+        status_control_select_t() : lookup_count(0), hit_count(0), probe_count(0), compare_count(0)
+        {
+        }
+        status_control_select_t(status_control_select_t const &other) : lookup_count(other.lookup_count.load(std::memory_order_relaxed)), hit_count(other.hit_count.load(std::memory_order_relaxed)), probe_count(other.probe_count.load(std::memory_order_relaxed)), compare_count(other.compare_count.load(std::memory_order_relaxed))
+        {
+        }
+        status_control_select_t &operator = (status_control_select_t const &other)
+        {
+            lookup_count.store(other.lookup_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            hit_count.store(other.hit_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            probe_count.store(other.probe_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            compare_count.store(other.compare_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+        static void lookup(status_control_select_t const &status, size_type probe, size_type compare, bool hit)
+        {
+            status.lookup_count.fetch_add(1, std::memory_order_relaxed);
+            if(hit)
+            {
+                status.hit_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            status.probe_count.fetch_add(probe, std::memory_order_relaxed);
+            status.compare_count.fetch_add(compare, std::memory_order_relaxed);
+        }
+        static status_t snapshot(status_control_select_t const &status)
+        {
+            status_t result;
+            result.lookup_count = status.lookup_count.load(std::memory_order_relaxed);
+            result.hit_count = status.hit_count.load(std::memory_order_relaxed);
+            result.probe_count = status.probe_count.load(std::memory_order_relaxed);
+            result.compare_count = status.compare_count.load(std::memory_order_relaxed);
+            return result;
+        }
+        mutable std::atomic<size_type> lookup_count;
+        mutable std::atomic<size_type> hit_count;
+        mutable std::atomic<size_type> probe_count;
+        mutable std::atomic<size_type> compare_count;
+    };
+    template<class unused_t> struct status_control_select_t<std::false_type, unused_t>
+    {
+        static void lookup(status_control_select_t const &, size_type, size_type, bool)
+        {
+        }
+    };
+    typedef status_control_select_t<typename contiguous_hash_detail::status_select_t<config_t>::type, void> status_control_t;
+    struct root_t : public hasher, public key_equal, public bucket_allocator_t, public index_allocator_t, public value_allocator_t, public bloom_t, public status_control_t
     {
         template<class any_hasher, class any_key_equal, class any_allocator_type> root_t(any_hasher &&hash, any_key_equal &&equal, any_allocator_type &&alloc)
             : hasher(std::forward<any_hasher>(hash))
@@ -392,6 +731,96 @@ public:
         contiguous_hash const *self;
     };
     typedef typename std::conditional<config_t::unique_type::value, std::pair<iterator, bool>, iterator>::type insert_result_t;
+
+    //owns one element taken out by extract, the element lives inside the handle and keeps its hash
+    class node_type
+    {
+    public:
+        node_type() : engaged_(false)
+        {
+        }
+        node_type(node_type &&other) : engaged_(false)
+        {
+            take_(other);
+        }
+        node_type &operator = (node_type &&other)
+        {
+            if(this != &other)
+            {
+                reset_();
+                take_(other);
+            }
+            return *this;
+        }
+        ~node_type()
+        {
+            reset_();
+        }
+        node_type(node_type const &) = delete;
+        node_type &operator = (node_type const &) = delete;
+
+        bool empty() const
+        {
+            return !engaged_;
+        }
+        explicit operator bool() const
+        {
+            return engaged_;
+        }
+        value_type &value() const
+        {
+            return *storage_.value();
+        }
+        key_type const &key() const
+        {
+            return get_key_t()(*storage_.value());
+        }
+        //map only
+        mapped_type &mapped() const
+        {
+            return storage_.value()->second;
+        }
+        //hash_function()(key()) with the top bit cleared, reused by insert
+        hash_value_type hash() const
+        {
+            return hash_.hash;
+        }
+
+    private:
+        friend class contiguous_hash;
+        template<class in_value_t> void emplace_(hash_t hash, in_value_t &&value)
+        {
+            construct_one_(storage_.value(), std::forward<in_value_t>(value));
+            hash_ = hash;
+            engaged_ = true;
+        }
+        void take_(node_type &other)
+        {
+            if(other.engaged_)
+            {
+                emplace_(other.hash_, std::move(*other.storage_.value()));
+                other.reset_();
+            }
+        }
+        void reset_()
+        {
+            if(engaged_)
+            {
+                destroy_one_(storage_.value());
+                engaged_ = false;
+            }
+        }
+        mutable value_t storage_;
+        hash_t hash_;
+        bool engaged_;
+    };
+    struct insert_return_type
+    {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+    typedef typename std::conditional<config_t::unique_type::value, insert_return_type, iterator>::type node_insert_result_t;
     typedef std::pair<iterator, bool> pair_ib_t;
 protected:
     typedef std::pair<size_type, bool> pair_posi_t;
@@ -522,6 +951,7 @@ public:
     {
         return *static_cast<value_allocator_t const *>(&root_);
     }
+    //copy of the hasher, hash_function()(key) is the value expected by the overloads taking a hash
     hasher hash_function() const
     {
         return *static_cast<hasher const *>(&root_);
@@ -536,6 +966,71 @@ public:
         std::swap(root_, other.root_);
     }
 
+    //write bucket/index/value arrays as they are in memory, open with contiguous_hash_view
+    void save(char const *path) const
+    {
+        static_assert(contiguous_hash_detail::is_trivial_expand<value_type>::value, "save requires trivial value_type");
+        typedef contiguous_hash_detail::image_header_t header_t;
+        header_t header;
+        std::memset(&header, 0, sizeof header);
+        std::memcpy(header.magic, contiguous_hash_detail::image_magic, sizeof header.magic);
+        header.offset_size = sizeof(offset_type);
+        header.index_size = sizeof(index_t);
+        header.value_size = sizeof(value_t);
+        header.value_align = std::alignment_of<value_t>::value;
+        header.bucket_count = root_.bucket_count;
+        header.size = root_.size;
+        header.free_count = root_.free_count;
+        header.bucket_position = contiguous_hash_detail::image_align_up(sizeof header);
+        header.index_position = contiguous_hash_detail::image_align_up(header.bucket_position + sizeof(offset_type) * root_.bucket_count);
+        header.value_position = contiguous_hash_detail::image_align_up(header.index_position + sizeof(index_t) * root_.size);
+        header.file_size = header.value_position + sizeof(value_t) * root_.size;
+
+        std::FILE *file = std::fopen(path, "wb");
+        if(file == nullptr)
+        {
+            throw std::runtime_error("contiguous_hash save failed");
+        }
+        char const zero[contiguous_hash_detail::image_align] = {};
+        std::uint64_t position = 0;
+        auto write = [&](void const *data, std::uint64_t length)
+        {
+            if(length != 0 && std::fwrite(data, 1, size_type(length), file) != length)
+            {
+                std::fclose(file);
+                throw std::runtime_error("contiguous_hash save failed");
+            }
+            position += length;
+        };
+        write(&header, sizeof header);
+        write(zero, header.bucket_position - position);
+        write(root_.bucket, sizeof(offset_type) * root_.bucket_count);
+        write(zero, header.index_position - position);
+        write(root_.index, sizeof(index_t) * root_.size);
+        write(zero, header.value_position - position);
+        value_t hole;
+        std::memset(&hole, 0, sizeof hole);
+        for(size_type i = 0; i < root_.size; )
+        {
+            size_type run = i;
+            while(run < root_.size && root_.index[run].hash)
+            {
+                ++run;
+            }
+            write(root_.value + i, sizeof(value_t) * (run - i));
+            if(run < root_.size)
+            {
+                write(&hole, sizeof(value_t));
+                ++run;
+            }
+            i = run;
+        }
+        if(std::fclose(file) != 0)
+        {
+            throw std::runtime_error("contiguous_hash save failed");
+        }
+    }
+
     typedef std::pair<iterator, iterator> pair_ii_t;
     typedef std::pair<const_iterator, const_iterator> pair_cici_t;
     typedef std::pair<local_iterator, local_iterator> pair_lili_t;
@@ -575,6 +1070,20 @@ public:
         insert(il.begin(), il.end());
     }
 
+    //replace content with [begin, end), construct hash and link on thread_count threads
+    template<class iterator_t> void build(iterator_t begin, iterator_t end, size_type thread_count)
+    {
+        static_assert(std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<iterator_t>::iterator_category>::value, "build requires random access iterator");
+        clear();
+        size_type count = size_type(end - begin);
+        if(count == 0)
+        {
+            return;
+        }
+        reserve(count);
+        build_(begin, count, std::max<size_type>(1, std::min(thread_count, count / 0x1000 + 1)));
+    }
+
     //single element
     template<class ...args_t> insert_result_t emplace(args_t &&...args)
     {
@@ -585,72 +1094,232 @@ public:
     {
         return result_<typename config_t::unique_type>(insert_value_(std::forward<args_t>(args)...));
     }
-
-    template<class in_key_t> iterator find(in_key_t const &key)
+    //hash must be hash_function()(key of the new element)
+    template<class ...args_t> insert_result_t emplace_with_hash(hash_value_type hash, args_t &&...args)
     {
-        if(root_.size == 0)
-        {
-            return end();
-        }
-        return iterator(find_value_(key), this);
+        return result_<typename config_t::unique_type>(insert_value_hash_(hash, std::forward<args_t>(args)...));
     }
-    template<class in_key_t> const_iterator find(in_key_t const &key) const
+
+    //move the element into a node handle, the value is moved not copied, the stored hash goes with it
+    node_type extract(const_iterator it)
     {
-        if(root_.size == 0)
-        {
-            return cend();
-        }
-        return const_iterator(find_value_(key), this);
+        node_type node;
+        node.emplace_(root_.index[it.offset].hash, std::move(*root_.value[it.offset].value()));
+        remove_offset_(it.offset);
+        return node;
     }
-
-    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type &at(in_key_t const &key)
+    //empty node if key is missing, in multi mode the first of the equal keys
+    node_type extract(key_type const &key)
     {
-        offset_type offset = root_.size;
-        if(root_.size != 0)
+        if(root_.size == 0)
         {
-            offset = find_value_(key);
+            return node_type();
         }
+        size_type offset = find_value_(key);
         if(offset == root_.size)
         {
-            throw std::out_of_range("contiguous_hash out of range");
+            return node_type();
         }
-        return root_.value[offset].value()->second;
+        return extract(const_iterator(offset, this));
     }
-    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type const &at(in_key_t const &key) const
+    //no rehash of the key, a unique table leaves the node untouched when the key exists
+    node_insert_result_t insert(node_type &&node)
     {
-        offset_type offset = root_.size;
-        if(root_.size != 0)
+        return insert_node_(typename config_t::unique_type(), node);
+    }
+    iterator insert(const_iterator hint, node_type &&node)
+    {
+        if(node.empty())
         {
-            offset = find_value_(key);
+            return end();
         }
-        if(offset == root_.size)
+        pair_posi_t result = insert_value_hash_(node.hash_, std::move(*node.storage_.value()));
+        if(result.second)
         {
-            throw std::out_of_range("contiguous_hash out of range");
+            node.reset_();
         }
-        return root_.value[offset].value()->second;
+        return iterator(result.first, this);
     }
-
-    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type &operator[](in_key_t &&key)
+    //move elements of other whose key is absent here, hashes are reused and values are moved, other keeps the rest
+    void merge(contiguous_hash &other)
     {
-        offset_type offset = root_.size;
-        if(root_.size != 0)
+        if(this == &other || other.size() == 0)
         {
-            offset = find_value_(key);
+            return;
         }
-        if(offset == root_.size)
+        for(size_type i = 0; i < other.root_.size; ++i)
         {
-            offset = insert_value_(key, mapped_type()).first;
+            if(!other.root_.index[i].hash)
+            {
+                continue;
+            }
+            hash_t hash = other.root_.index[i].hash;
+            if(config_t::unique_type::value && root_.size != 0 && find_value_(get_key_t()(*other.root_.value[i].value()), hash) != root_.size)
+            {
+                continue;
+            }
+            check_grow_();
+            size_type offset = construct_offset_(std::move(*other.root_.value[i].value()));
+            set_hash_(offset, hash);
+            if(config_t::unique_type::value)
+            {
+                link_head_(hash % root_.bucket_count, offset);
+            }
+            else
+            {
+                link_offset_(std::false_type(), offset);
+            }
+            other.remove_offset_(i);
         }
-        return root_.value[offset].value()->second;
+    }
+    void merge(contiguous_hash &&other)
+    {
+        merge(other);
     }
 
-    iterator erase(const_iterator it)
+    template<class in_key_t> iterator find(in_key_t const &key)
     {
         if(root_.size == 0)
         {
             return end();
         }
-        remove_offset_(it.offset);
+        return iterator(find_value_(key), this);
+    }
+    template<class in_key_t> const_iterator find(in_key_t const &key) const
+    {
+        if(root_.size == 0)
+        {
+            return cend();
+        }
+        return const_iterator(find_value_(key), this);
+    }
+    //hash must be hash_function()(key), lets one hash serve several tables with the same hasher
+    template<class in_key_t> iterator find(in_key_t const &key, hash_value_type hash)
+    {
+        if(root_.size == 0)
+        {
+            return end();
+        }
+        return iterator(find_value_(key, hash), this);
+    }
+    //hash must be hash_function()(key), lets one hash serve several tables with the same hasher
+    template<class in_key_t> const_iterator find(in_key_t const &key, hash_value_type hash) const
+    {
+        if(root_.size == 0)
+        {
+            return cend();
+        }
+        return const_iterator(find_value_(key, hash), this);
+    }
+
+    //slot of an element, stable until compaction (shrink_to_fit, or an insert past compact_proportion) renumbers slots
+    //with a 32 bit offset_type a slot id fits 4 bytes, a secondary index can keep ids instead of keys
+    size_type slot_id(const_iterator it) const
+    {
+        return it.offset;
+    }
+    //ids are below slot_count(), dead slots included
+    size_type slot_count() const
+    {
+        return root_.size;
+    }
+    bool slot_valid(size_type id) const
+    {
+        return id < root_.size && root_.index[id].hash;
+    }
+    value_type &at_slot(size_type id)
+    {
+        if(!slot_valid(id))
+        {
+            throw std::out_of_range("contiguous_hash slot out of range");
+        }
+        return *root_.value[id].value();
+    }
+    value_type const &at_slot(size_type id) const
+    {
+        if(!slot_valid(id))
+        {
+            throw std::out_of_range("contiguous_hash slot out of range");
+        }
+        return *root_.value[id].value();
+    }
+    //end() if id is not a live slot
+    iterator iterator_at_slot(size_type id)
+    {
+        return slot_valid(id) ? iterator(id, this) : end();
+    }
+    const_iterator iterator_at_slot(size_type id) const
+    {
+        return slot_valid(id) ? const_iterator(id, this) : cend();
+    }
+
+    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type &at(in_key_t const &key)
+    {
+        offset_type offset = root_.size;
+        if(root_.size != 0)
+        {
+            offset = find_value_(key);
+        }
+        if(offset == root_.size)
+        {
+            throw std::out_of_range("contiguous_hash out of range");
+        }
+        return root_.value[offset].value()->second;
+    }
+    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type const &at(in_key_t const &key) const
+    {
+        offset_type offset = root_.size;
+        if(root_.size != 0)
+        {
+            offset = find_value_(key);
+        }
+        if(offset == root_.size)
+        {
+            throw std::out_of_range("contiguous_hash out of range");
+        }
+        return root_.value[offset].value()->second;
+    }
+
+    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, void>::type> mapped_type &operator[](in_key_t &&key)
+    {
+        size_type offset = try_insert_value_(std::forward<in_key_t>(key)).first;
+        return root_.value[offset].value()->second;
+    }
+
+    //mapped_type is constructed from args only if key is absent, one hash and one chain walk
+    template<class in_key_t, class ...args_t> typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, std::pair<iterator, bool>>::type try_emplace(in_key_t &&key, args_t &&...args)
+    {
+        return result_<std::true_type>(try_insert_value_(std::forward<in_key_t>(key), std::forward<args_t>(args)...));
+    }
+    //insert if key is absent, else assign mapped_type
+    template<class in_key_t, class in_mapped_t> typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, std::pair<iterator, bool>>::type insert_or_assign(in_key_t &&key, in_mapped_t &&mapped)
+    {
+        pair_posi_t result = try_insert_value_(std::forward<in_key_t>(key), std::forward<in_mapped_t>(mapped));
+        if(!result.second)
+        {
+            root_.value[result.first].value()->second = std::forward<in_mapped_t>(mapped);
+        }
+        return result_<std::true_type>(result);
+    }
+    //key absent : mapped_type constructed from on_insert()
+    //key exists : on_update(mapped_type &)
+    template<class in_key_t, class insert_t, class update_t> typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && config_t::unique_type::value && !std::is_same<key_type, value_type>::value, std::pair<iterator, bool>>::type upsert(in_key_t &&key, insert_t &&on_insert, update_t &&on_update)
+    {
+        pair_posi_t result = try_insert_lazy_(std::forward<in_key_t>(key), on_insert);
+        if(!result.second)
+        {
+            on_update(root_.value[result.first].value()->second);
+        }
+        return result_<std::true_type>(result);
+    }
+
+    iterator erase(const_iterator it)
+    {
+        if(root_.size == 0)
+        {
+            return end();
+        }
+        remove_offset_(it.offset);
         return iterator(advance_next_(it.offset), this);
     }
     local_iterator erase(const_local_iterator it)
@@ -663,13 +1332,23 @@ public:
         remove_offset_(it.offset);
         return local_iterator(next, this);
     }
+    //never compacts, holes left behind are reclaimed by a later insert
     size_type erase(key_type const &key)
     {
         if(root_.size == 0)
         {
             return 0;
         }
-        return remove_value_(typename config_t::unique_type(), key);
+        return erase(key, get_hasher()(key));
+    }
+    //hash must be hash_function()(key)
+    size_type erase(key_type const &key, hash_value_type hash)
+    {
+        if(root_.size == 0)
+        {
+            return 0;
+        }
+        return remove_value_(typename config_t::unique_type(), key, hash);
     }
     iterator erase(const_iterator erase_begin, const_iterator erase_end)
     {
@@ -695,6 +1374,55 @@ public:
         }
         return local_iterator(erase_begin.offset, this);
     }
+    //remove every element matching pred(value_type &) in one walk of the slot array, return count removed
+    //matches are destroyed in place and never unlinked one by one, the buckets are rebuilt once afterwards
+    //compact moves survivors down in the same walk keeping their order (a multi table packs them after the relink)
+    //thread_count > 1 walks slot ranges concurrently, each range packs its own survivors and the ranges are joined
+    //if pred throws, elements already matched are removed, iterators are invalidated
+    template<class pred_t> size_type erase_if(pred_t &&pred, bool compact = false, size_type thread_count = 1)
+    {
+        if(size() == 0)
+        {
+            return 0;
+        }
+        size_type old_size = size();
+        size_type part_count = thread_count <= 1 || root_.size < 0x1000 ? 1 : thread_count;
+        bool move_down = compact && config_t::unique_type::value;
+        std::vector<size_type> live(part_count);
+        std::vector<std::exception_ptr> error(part_count);
+        contiguous_hash_detail::parallel_for(part_count, [&](size_type t)
+        {
+            live[t] = erase_range_if_(pred, root_.size * t / part_count, root_.size * (t + 1) / part_count, move_down, error[t]);
+        });
+        if(move_down)
+        {
+            size_type to = live[0];
+            for(size_type t = 1; t < part_count; ++t)
+            {
+                size_type from = root_.size * t / part_count;
+                for(size_type i = from; i < from + live[t]; ++i, ++to)
+                {
+                    move_slot_(i, to);
+                }
+            }
+            std::memset(root_.index + to, 0xFFFFFFFF, sizeof(index_t) * (root_.size - to));
+            root_.size = to;
+        }
+        relink_(typename config_t::unique_type());
+        if(compact && !move_down)
+        {
+            compact_();
+        }
+        bloom_rebuild_();
+        for(auto &item : error)
+        {
+            if(item)
+            {
+                std::rethrow_exception(item);
+            }
+        }
+        return old_size - size();
+    }
 
     size_type count(key_type const &key) const
     {
@@ -826,6 +1554,67 @@ public:
         return max_size();
     }
 
+    //walks every chain once, chain hashes are sorted to count full hash collisions
+    probe_stats_t probe_stats() const
+    {
+        probe_stats_t stats;
+        stats.size = size();
+        stats.slot_count = root_.size;
+        stats.free_count = root_.free_count;
+        stats.capacity = root_.capacity;
+        stats.bucket_count = root_.bucket_count;
+        stats.load_factor = load_factor();
+        stats.success_probe = 0;
+        stats.success_compare = 0;
+        stats.fail_probe = 0;
+        stats.fail_compare = 0;
+        double success_probe = 0, success_compare = 0, fail_compare = 0;
+        std::vector<std::pair<hash_value_type, size_type>> chain;
+        for(size_type b = 0; b < root_.bucket_count; ++b)
+        {
+            chain.clear();
+            for(size_type i = root_.bucket[b]; i != offset_empty; i = root_.index[i].next)
+            {
+                chain.emplace_back(root_.index[i].hash.hash, chain.size() + 1);
+            }
+            if(stats.chain_histogram.size() <= chain.size())
+            {
+                stats.chain_histogram.resize(chain.size() + 1, 0);
+            }
+            ++stats.chain_histogram[chain.size()];
+            std::sort(chain.begin(), chain.end());
+            for(size_type i = 0, end; i < chain.size(); i = end)
+            {
+                for(end = i; end < chain.size() && chain[end].first == chain[i].first; ++end)
+                {
+                    success_probe += chain[end].second;
+                }
+                //a run of equal hashes, the k-th in chain order compares k times
+                double run = double(end - i);
+                success_compare += run * (run + 1) / 2;
+                fail_compare += run * run;
+            }
+        }
+        if(stats.size != 0)
+        {
+            stats.success_probe = success_probe / stats.size;
+            stats.success_compare = success_compare / stats.size;
+            stats.fail_compare = fail_compare / stats.size;
+        }
+        if(stats.bucket_count != 0)
+        {
+            stats.fail_probe = double(stats.size) / stats.bucket_count;
+        }
+        return stats;
+    }
+
+    //a snapshot, the counters may move on while other threads look up
+    status_t status() const
+    {
+        static_assert(contiguous_hash_detail::status_select_t<config_t>::type::value, "status disabled");
+        return status_control_t::snapshot(root_);
+    }
+
     size_type bucket_size(size_type n) const
     {
         size_type step = 0;
@@ -848,9 +1637,29 @@ public:
     void reserve(size_type count)
     {
         rehash(size_type(std::ceil(count / root_.setting_load_factor)));
-        if(count > root_.capacity && root_.capacity <= max_size())
+        //ordered mode does not refill holes, count more slots after them
+        size_type slot_count = ordered_select_t::value && count > size() ? root_.size + (count - size()) : count;
+        if(slot_count > root_.capacity && root_.capacity <= max_size())
+        {
+            realloc_(size_type(std::ceil(std::max<float>(float(slot_count), root_.bucket_count * root_.setting_load_factor))));
+        }
+    }
+    //compact live elements to the front, then fit bucket_count and capacity to size
+    void shrink_to_fit()
+    {
+        compact_();
+        rehash(0);
+        if(root_.size == 0 && root_.capacity != 0)
+        {
+            get_index_allocator_().deallocate(root_.index, root_.capacity);
+            get_value_allocator_().deallocate(root_.value, root_.capacity);
+            root_.capacity = 0;
+            root_.index = nullptr;
+            root_.value = nullptr;
+        }
+        else if(root_.capacity > root_.size)
         {
-            realloc_(size_type(std::ceil(std::max<float>(float(count), root_.bucket_count * root_.setting_load_factor))));
+            realloc_(root_.size);
         }
     }
     void rehash(size_type count)
@@ -858,6 +1667,124 @@ public:
         rehash_(typename config_t::unique_type(), std::max<size_type>({8, count, size_type(std::ceil(size() / root_.setting_load_factor))}));
     }
 
+    //same as rehash(count), old buckets are relinked on thread_count threads
+    void rehash(size_type count, size_type thread_count)
+    {
+        size_type new_count = std::max<size_type>({8, count, size_type(std::ceil(size() / root_.setting_load_factor))});
+        if(thread_count <= 1 || root_.bucket_count == 0 || size() < 0x1000)
+        {
+            rehash_(typename config_t::unique_type(), new_count);
+        }
+        else
+        {
+            rehash_parallel_(new_count, thread_count);
+        }
+    }
+
+    //set algebra for unique tables, both tables must hash with equal hashers, stored hashes are reused
+    //the smaller side is iterated over its dense slot array and the other side is probed in prefetched batches
+    //keep elements whose key is in other
+    void set_intersect(contiguous_hash const &other)
+    {
+        static_assert(config_t::unique_type::value, "set algebra requires unique keys");
+        if(this == &other)
+        {
+            return;
+        }
+        if(other.size() < size())
+        {
+            contiguous_hash result = intersect_(other, *this);
+            swap(result);
+            return;
+        }
+        batch_probe_(*this, other, [this, &other](size_type offset, size_type found)
+        {
+            if(found == other.root_.size)
+            {
+                remove_offset_(offset);
+            }
+        });
+    }
+    //insert elements of other whose key is absent, existing elements are kept
+    void set_union(contiguous_hash const &other)
+    {
+        static_assert(config_t::unique_type::value, "set algebra requires unique keys");
+        if(this == &other)
+        {
+            return;
+        }
+        reserve(size() + other.size());
+        batch_probe_(other, *this, [this, &other](size_type offset, size_type found)
+        {
+            if(found == root_.size)
+            {
+                append_unique_(other.root_.index[offset].hash, *other.root_.value[offset].value());
+            }
+        });
+    }
+    //remove elements whose key is in other
+    void set_difference(contiguous_hash const &other)
+    {
+        static_assert(config_t::unique_type::value, "set algebra requires unique keys");
+        if(this == &other)
+        {
+            clear();
+            return;
+        }
+        if(other.size() < size())
+        {
+            batch_probe_(other, *this, [this](size_type, size_type found)
+            {
+                if(found != root_.size)
+                {
+                    remove_offset_(found);
+                }
+            });
+        }
+        else
+        {
+            batch_probe_(*this, other, [this, &other](size_type offset, size_type found)
+            {
+                if(found != other.root_.size)
+                {
+                    remove_offset_(offset);
+                }
+            });
+        }
+    }
+    //new table, values are copied from left
+    friend contiguous_hash set_intersect(contiguous_hash const &left, contiguous_hash const &right)
+    {
+        static_assert(config_t::unique_type::value, "set algebra requires unique keys");
+        return left.intersect_(right, left);
+    }
+    //new table, values of left win on equal keys
+    friend contiguous_hash set_union(contiguous_hash const &left, contiguous_hash const &right)
+    {
+        contiguous_hash result(left);
+        result.set_union(right);
+        return result;
+    }
+    //new table, values are copied from left
+    friend contiguous_hash set_difference(contiguous_hash const &left, contiguous_hash const &right)
+    {
+        static_assert(config_t::unique_type::value, "set algebra requires unique keys");
+        if(right.size() == 0)
+        {
+            return left;
+        }
+        contiguous_hash result(0, left.get_hasher(), left.get_key_equal(), left.get_allocator());
+        result.reserve(left.size());
+        batch_probe_(left, right, [&result, &left, &right](size_type offset, size_type found)
+        {
+            if(found == right.root_.size)
+            {
+                result.append_unique_(left.root_.index[offset].hash, *left.root_.value[offset].value());
+            }
+        });
+        return result;
+    }
+
     void max_load_factor(float ml)
     {
         if(ml <= 0)
@@ -930,6 +1857,37 @@ protected:
     {
         return root_;
     }
+    bloom_t &get_bloom_()
+    {
+        return root_;
+    }
+    bloom_t const &get_bloom_() const
+    {
+        return root_;
+    }
+
+    //store the hash of a new slot, the filter learns it here
+    void set_hash_(size_type offset, hash_t hash)
+    {
+        root_.index[offset].hash = hash;
+        get_bloom_().insert(hash.hash);
+    }
+    //filter sized for the current bucket_count, refilled from every live slot
+    void bloom_rebuild_()
+    {
+        if(!bloom_select_t::value)
+        {
+            return;
+        }
+        get_bloom_().reset(size_type(std::ceil(root_.bucket_count * root_.setting_load_factor)));
+        for(size_type i = 0; i < root_.size; ++i)
+        {
+            if(root_.index[i].hash)
+            {
+                get_bloom_().insert(root_.index[i].hash.hash);
+            }
+        }
+    }
 
     size_type advance_next_(size_type i) const
     {
@@ -1026,6 +1984,7 @@ protected:
         root_.size = 0;
         root_.free_count = 0;
         root_.free_list = offset_empty;
+        get_bloom_().clear();
     }
 
     template<bool move> void copy_all_(root_t const *other)
@@ -1056,7 +2015,7 @@ protected:
                     }
                     root_.index[i].prev = offset_empty;
                     root_.index[i].next = root_.bucket[bucket];
-                    root_.index[i].hash = other->index[other_i].hash;
+                    set_hash_(i, other->index[other_i].hash);
                     root_.bucket[bucket] = offset_type(i);
                     if(move)
                     {
@@ -1141,6 +2100,7 @@ protected:
             }
         }
         root_.bucket_count = size;
+        bloom_rebuild_();
     }
 
     void rehash_(std::false_type, size_type size)
@@ -1176,43 +2136,476 @@ protected:
         }
         root_.bucket_count = size;
         root_.bucket = new_bucket;
+        bloom_rebuild_();
     }
 
-    void realloc_(size_type size)
+    typedef std::vector<offset_type> offset_list_t;
+
+    static size_type bucket_part_(size_type bucket, size_type bucket_count, size_type part_count)
     {
-        if(size * sizeof(value_t) > 0x1000)
-        {
-            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x1000) - 1) & (~size_type(0) ^ 0xFFF)) / sizeof(value_t);
-        }
-        else if(size * sizeof(value_t) > 0x100)
-        {
-            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x100) - 1) & (~size_type(0) ^ 0xFF)) / sizeof(value_t);
-        }
-        else
-        {
-            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x10) - 1) & (~size_type(0) ^ 0xF)) / sizeof(value_t);
-        }
-        size = std::min(size, max_size());
-        index_t *new_index = get_index_allocator_().allocate(size);
-        value_t *new_value = get_value_allocator_().allocate(size);
+        return size_type(std::uint64_t(bucket) * part_count / bucket_count);
+    }
 
-        std::memset(new_index + root_.capacity, 0xFFFFFFFF, sizeof(index_t) * (size - root_.capacity));
-        if(root_.capacity != 0)
+    void link_head_(size_type bucket, size_type offset)
+    {
+        root_.index[offset].next = root_.bucket[bucket];
+        root_.index[offset].prev = offset_empty;
+        if(root_.bucket[bucket] != offset_empty)
         {
-            std::memcpy(new_index, root_.index, sizeof(index_t) * root_.capacity);
-            move_construct_and_destroy_(root_.value->value(), root_.value->value() + root_.capacity, new_value->value());
-            get_index_allocator_().deallocate(root_.index, root_.capacity);
-            get_value_allocator_().deallocate(root_.value, root_.capacity);
+            root_.index[root_.bucket[bucket]].prev = offset_type(offset);
         }
-        root_.capacity = size;
-        root_.index = new_index;
-        root_.value = new_value;
+        root_.bucket[bucket] = offset_type(offset);
     }
 
-    void check_grow_()
+    //link a constructed slot, false if key already exists
+    bool link_offset_(std::true_type, size_type offset)
     {
-        size_type new_size = size() + 1;
-        if(new_size > root_.bucket_count * root_.setting_load_factor)
+        hash_t hash = root_.index[offset].hash;
+        size_type bucket = hash % root_.bucket_count;
+        for(size_type i = root_.bucket[bucket]; i != offset_empty; i = root_.index[i].next)
+        {
+            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), get_key_t()(*root_.value[offset].value())))
+            {
+                return false;
+            }
+        }
+        link_head_(bucket, offset);
+        return true;
+    }
+
+    //link a constructed slot next to its equal keys
+    bool link_offset_(std::false_type, size_type offset)
+    {
+        hash_t hash = root_.index[offset].hash;
+        size_type bucket = hash % root_.bucket_count;
+        size_type where;
+        for(where = root_.bucket[bucket]; where != offset_empty; where = root_.index[where].next)
+        {
+            if(root_.index[where].hash == hash && get_key_equal()(get_key_t()(*root_.value[where].value()), get_key_t()(*root_.value[offset].value())))
+            {
+                break;
+            }
+        }
+        if(where == offset_empty)
+        {
+            link_head_(bucket, offset);
+        }
+        else
+        {
+            root_.index[offset].next = root_.index[where].next;
+            root_.index[offset].prev = offset_type(where);
+            root_.index[where].next = offset_type(offset);
+            if(root_.index[offset].next != offset_empty)
+            {
+                root_.index[root_.index[offset].next].prev = offset_type(offset);
+            }
+        }
+        return true;
+    }
+
+    //empty table with capacity >= count
+    //pass 1 constructs slot ranges and sorts offsets by bucket range, pass 2 links each bucket range
+    template<class iterator_t> void build_(iterator_t begin, size_type count, size_type thread_count)
+    {
+        std::vector<offset_list_t> part(thread_count * thread_count);
+        std::vector<size_type> built(thread_count, 0);
+        try
+        {
+            contiguous_hash_detail::parallel_for(thread_count, [&](size_type t)
+            {
+                size_type i = count * t / thread_count, end = count * (t + 1) / thread_count;
+                for(; i < end; ++i)
+                {
+                    construct_one_(root_.value[i].value(), begin[i]);
+                    ++built[t];
+                    hash_t hash = get_hasher()(get_key_t()(*root_.value[i].value()));
+                    root_.index[i].hash = hash;
+                    part[t * thread_count + bucket_part_(hash % root_.bucket_count, root_.bucket_count, thread_count)].push_back(offset_type(i));
+                }
+            });
+        }
+        catch(...)
+        {
+            for(size_type t = 0; t < thread_count; ++t)
+            {
+                size_type i = count * t / thread_count;
+                for(size_type end = i + built[t]; i < end; ++i)
+                {
+                    destroy_one_(root_.value[i].value());
+                    root_.index[i].hash.clear();
+                }
+            }
+            throw;
+        }
+        root_.size = count;
+        std::vector<offset_list_t> duplicate(thread_count);
+        try
+        {
+            contiguous_hash_detail::parallel_for(thread_count, [&](size_type p)
+            {
+                for(size_type t = 0; t < thread_count; ++t)
+                {
+                    for(offset_type offset : part[t * thread_count + p])
+                    {
+                        if(!link_offset_(typename config_t::unique_type(), offset))
+                        {
+                            duplicate[p].push_back(offset);
+                            destroy_one_(root_.value[offset].value());
+                            root_.index[offset].hash.clear();
+                        }
+                    }
+                }
+            });
+        }
+        catch(...)
+        {
+            clear_all_();
+            throw;
+        }
+        for(auto &list : duplicate)
+        {
+            for(offset_type offset : list)
+            {
+                root_.index[offset].next = root_.free_list;
+                root_.free_list = offset;
+                ++root_.free_count;
+            }
+        }
+        bloom_rebuild_();
+    }
+
+    //pass 1 walks old bucket ranges and sorts offsets by new bucket range, pass 2 links each new bucket range
+    //equal keys stay adjacent, they come from one old chain and land in one new chain
+    void rehash_parallel_(size_type size, size_type thread_count)
+    {
+        size = std::min(get_prime_(size), max_size());
+        offset_type *new_bucket = get_bucket_allocator_().allocate(size);
+        std::memset(new_bucket, 0xFFFFFFFF, sizeof(offset_type) * size);
+        std::vector<offset_list_t> part(thread_count * thread_count);
+        try
+        {
+            contiguous_hash_detail::parallel_for(thread_count, [&](size_type t)
+            {
+                size_type end = root_.bucket_count * (t + 1) / thread_count;
+                for(size_type i = root_.bucket_count * t / thread_count; i < end; ++i)
+                {
+                    for(size_type j = root_.bucket[i]; j != offset_empty; j = root_.index[j].next)
+                    {
+                        part[t * thread_count + bucket_part_(root_.index[j].hash % size, size, thread_count)].push_back(offset_type(j));
+                    }
+                }
+            });
+        }
+        catch(...)
+        {
+            get_bucket_allocator_().deallocate(new_bucket, size);
+            throw;
+        }
+        contiguous_hash_detail::parallel_for(thread_count, [&](size_type p)
+        {
+            for(size_type t = 0; t < thread_count; ++t)
+            {
+                for(offset_type j : part[t * thread_count + p])
+                {
+                    size_type bucket = root_.index[j].hash % size;
+                    if(new_bucket[bucket] != offset_empty)
+                    {
+                        root_.index[new_bucket[bucket]].prev = j;
+                    }
+                    root_.index[j].prev = offset_empty;
+                    root_.index[j].next = new_bucket[bucket];
+                    new_bucket[bucket] = j;
+                }
+            }
+        });
+        get_bucket_allocator_().deallocate(root_.bucket, root_.bucket_count);
+        root_.bucket_count = size;
+        root_.bucket = new_bucket;
+        bloom_rebuild_();
+    }
+
+    void realloc_(size_type size)
+    {
+        if(size * sizeof(value_t) > 0x1000)
+        {
+            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x1000) - 1) & (~size_type(0) ^ 0xFFF)) / sizeof(value_t);
+        }
+        else if(size * sizeof(value_t) > 0x100)
+        {
+            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x100) - 1) & (~size_type(0) ^ 0xFF)) / sizeof(value_t);
+        }
+        else
+        {
+            size = ((size * sizeof(value_t) + std::max<size_type>(sizeof(value_t), 0x10) - 1) & (~size_type(0) ^ 0xF)) / sizeof(value_t);
+        }
+        size = std::max(std::min(size, max_size()), root_.size);
+        //an allocator with reallocate resizes in place or by remapping, trivial values may move with it
+        index_t *new_index = nullptr;
+        value_t *new_value = nullptr;
+        if(root_.capacity != 0)
+        {
+            new_index = contiguous_hash_detail::try_reallocate(get_index_allocator_(), root_.index, root_.capacity, size, contiguous_hash_detail::has_reallocate<index_allocator_t>());
+            if(contiguous_hash_detail::is_trivial_expand<value_type>::value)
+            {
+                new_value = contiguous_hash_detail::try_reallocate(get_value_allocator_(), root_.value, root_.capacity, size, contiguous_hash_detail::has_reallocate<value_allocator_t>());
+            }
+        }
+        bool index_moved = new_index != nullptr, value_moved = new_value != nullptr;
+        try
+        {
+            if(!index_moved)
+            {
+                new_index = get_index_allocator_().allocate(size);
+            }
+            if(!value_moved)
+            {
+                new_value = get_value_allocator_().allocate(size);
+            }
+        }
+        catch(...)
+        {
+            //resizing back a remapped block does not fail in practice, keep the remapped one if it does
+            if(index_moved)
+            {
+                index_t *old_index = contiguous_hash_detail::try_reallocate(get_index_allocator_(), new_index, size, root_.capacity, contiguous_hash_detail::has_reallocate<index_allocator_t>());
+                root_.index = old_index == nullptr ? new_index : old_index;
+            }
+            else if(new_index != nullptr)
+            {
+                get_index_allocator_().deallocate(new_index, size);
+            }
+            if(value_moved)
+            {
+                value_t *old_value = contiguous_hash_detail::try_reallocate(get_value_allocator_(), new_value, size, root_.capacity, contiguous_hash_detail::has_reallocate<value_allocator_t>());
+                root_.value = old_value == nullptr ? new_value : old_value;
+            }
+            throw;
+        }
+
+        if(size > root_.capacity)
+        {
+            std::memset(new_index + root_.capacity, 0xFFFFFFFF, sizeof(index_t) * (size - root_.capacity));
+        }
+        if(root_.capacity != 0)
+        {
+            if(!index_moved)
+            {
+                std::memcpy(new_index, root_.index, sizeof(index_t) * std::min(size, root_.capacity));
+                get_index_allocator_().deallocate(root_.index, root_.capacity);
+            }
+            if(!value_moved)
+            {
+                if(contiguous_hash_detail::is_trivial_expand<value_type>::value)
+                {
+                    move_construct_and_destroy_(root_.value->value(), root_.value->value() + root_.size, new_value->value());
+                }
+                else
+                {
+                    for(size_type i = 0; i < root_.size; ++i)
+                    {
+                        if(new_index[i].hash)
+                        {
+                            move_construct_and_destroy_(root_.value[i].value(), root_.value[i].value() + 1, new_value[i].value());
+                        }
+                    }
+                }
+                get_value_allocator_().deallocate(root_.value, root_.capacity);
+            }
+        }
+        root_.capacity = size;
+        root_.index = new_index;
+        root_.value = new_value;
+    }
+
+    //move live slots down keeping their order, chains and buckets follow, free list becomes empty
+    void compact_()
+    {
+        if(root_.free_count == 0)
+        {
+            return;
+        }
+        std::vector<offset_type> remap(root_.size, offset_empty);
+        size_type live = 0;
+        for(size_type i = 0; i < root_.size; ++i)
+        {
+            if(root_.index[i].hash)
+            {
+                remap[i] = offset_type(live++);
+            }
+        }
+        for(size_type i = 0; i < root_.bucket_count; ++i)
+        {
+            if(root_.bucket[i] != offset_empty)
+            {
+                root_.bucket[i] = remap[root_.bucket[i]];
+            }
+        }
+        for(size_type i = 0; i < root_.size; ++i)
+        {
+            if(root_.index[i].hash)
+            {
+                index_t &index = root_.index[i];
+                if(index.next != offset_empty)
+                {
+                    index.next = remap[index.next];
+                }
+                if(index.prev != offset_empty)
+                {
+                    index.prev = remap[index.prev];
+                }
+                size_type to = remap[i];
+                if(to != i)
+                {
+                    root_.index[to] = index;
+                    move_construct_and_destroy_(root_.value[i].value(), root_.value[i].value() + 1, root_.value[to].value());
+                }
+            }
+        }
+        std::memset(root_.index + live, 0xFFFFFFFF, sizeof(index_t) * (root_.size - live));
+        root_.size = live;
+        root_.free_count = 0;
+        root_.free_list = offset_empty;
+    }
+
+    //erase_if on [begin, end), a match is destroyed and its slot cleared but left in its chain
+    //move_down packs the survivors to the front of the range and returns their count
+    //a throwing pred stops the matching, the rest of the range survives and the exception goes to error
+    template<class pred_t> size_type erase_range_if_(pred_t &pred, size_type begin, size_type end, bool move_down, std::exception_ptr &error)
+    {
+        size_type to = begin;
+        for(size_type i = begin; i < end; ++i)
+        {
+            if(!root_.index[i].hash)
+            {
+                continue;
+            }
+            if(!error)
+            {
+                bool match = false;
+                try
+                {
+                    match = pred(*root_.value[i].value());
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+                if(match)
+                {
+                    destroy_one_(root_.value[i].value());
+                    root_.index[i].hash.clear();
+                    continue;
+                }
+            }
+            if(move_down)
+            {
+                move_slot_(i, to++);
+            }
+        }
+        return to - begin;
+    }
+
+    //the links of the slot are copied as they are, the caller relinks
+    void move_slot_(size_type from, size_type to)
+    {
+        if(from != to)
+        {
+            root_.index[to] = root_.index[from];
+            move_construct_and_destroy_(root_.value[from].value(), root_.value[from].value() + 1, root_.value[to].value());
+            root_.index[from].hash.clear();
+        }
+    }
+
+    //after erase_if cleared slots in place : chains from the stored hashes, free list from the cleared slots
+    void relink_(std::true_type)
+    {
+        std::memset(root_.bucket, 0xFFFFFFFF, sizeof(offset_type) * root_.bucket_count);
+        root_.free_list = offset_empty;
+        root_.free_count = 0;
+        for(size_type i = root_.size; i-- > 0; )
+        {
+            if(root_.index[i].hash)
+            {
+                size_type bucket = root_.index[i].hash % root_.bucket_count;
+                if(root_.bucket[bucket] != offset_empty)
+                {
+                    root_.index[root_.bucket[bucket]].prev = offset_type(i);
+                }
+                root_.index[i].prev = offset_empty;
+                root_.index[i].next = root_.bucket[bucket];
+                root_.bucket[bucket] = offset_type(i);
+            }
+            else
+            {
+                root_.index[i].next = root_.free_list;
+                root_.free_list = offset_type(i);
+                ++root_.free_count;
+            }
+        }
+    }
+    //equal keys must stay adjacent, so the old chains are walked and cleared slots skipped
+    void relink_(std::false_type)
+    {
+        for(size_type b = 0; b < root_.bucket_count; ++b)
+        {
+            size_type last = offset_empty;
+            for(size_type i = root_.bucket[b], next; i != offset_empty; i = next)
+            {
+                next = root_.index[i].next;
+                if(!root_.index[i].hash)
+                {
+                    continue;
+                }
+                root_.index[i].prev = offset_type(last);
+                if(last == offset_empty)
+                {
+                    root_.bucket[b] = offset_type(i);
+                }
+                else
+                {
+                    root_.index[last].next = offset_type(i);
+                }
+                last = i;
+            }
+            if(last == offset_empty)
+            {
+                root_.bucket[b] = offset_empty;
+            }
+            else
+            {
+                root_.index[last].next = offset_empty;
+            }
+        }
+        relink_free_list_();
+    }
+    void relink_free_list_()
+    {
+        root_.free_list = offset_empty;
+        root_.free_count = 0;
+        for(size_type i = root_.size; i-- > 0; )
+        {
+            if(!root_.index[i].hash)
+            {
+                root_.index[i].next = root_.free_list;
+                root_.free_list = offset_type(i);
+                ++root_.free_count;
+            }
+        }
+    }
+
+    //inserts may reallocate anyway, so holes are reclaimed here and never under an erase loop
+    void check_grow_()
+    {
+        if(root_.free_count != 0 && root_.size >= 0x100)
+        {
+            float proportion = compact_select_t::proportion(root_.capacity);
+            if(proportion > 1 && root_.size > size() * proportion)
+            {
+                shrink_to_fit();
+            }
+        }
+        size_type new_size = size() + 1;
+        if(new_size > root_.bucket_count * root_.setting_load_factor)
         {
             if(root_.bucket_count >= max_size())
             {
@@ -1220,7 +2613,11 @@ protected:
             }
             rehash_(typename config_t::unique_type(), size_type(std::ceil(root_.bucket_count * config_t::grow_proportion(root_.bucket_count))));
         }
-        if(new_size > root_.capacity)
+        if(ordered_select_t::value && root_.size + 1 > root_.capacity && root_.free_count * 2 >= root_.size)
+        {
+            compact_();
+        }
+        if((ordered_select_t::value ? root_.size + 1 : new_size) > root_.capacity)
         {
             if(root_.capacity >= max_size())
             {
@@ -1230,82 +2627,170 @@ protected:
         }
     }
 
+    //a unique table grows in insert_value_hash_uncheck_ after the chain walk, so a hit never grows
     template<class ...args_t> pair_posi_t insert_value_(args_t &&...args)
     {
-        check_grow_();
+        if(!config_t::unique_type::value)
+        {
+            check_grow_();
+        }
         return insert_value_uncheck_(typename config_t::unique_type(), std::forward<args_t>(args)...);
     }
 
-    template<class in_t, class ...args_t> typename std::enable_if<std::is_same<key_type, value_type>::value && !std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_uncheck_(std::true_type, in_t &&in, args_t &&...args)
+    //unique map only, grow is checked after the chain walk so a hit never grows
+    template<class in_key_t, class ...args_t> pair_posi_t try_insert_value_(in_key_t &&key, args_t &&...args)
     {
-        key_type key = get_key_t()(in, args...);
         hash_t hash = get_hasher()(key);
-        size_type bucket = hash % root_.bucket_count;
-        for(size_type i = root_.bucket[bucket]; i != offset_empty; i = root_.index[i].next)
+        size_type offset = find_or_grow_(key, hash);
+        if(offset != root_.size)
         {
-            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), get_key_t()(key)))
-            {
-                return std::make_pair(i, false);
-            }
+            return std::make_pair(offset, false);
         }
-        size_type offset = root_.free_list == offset_empty ? root_.size : root_.free_list;
-        construct_one_(root_.value[offset].value(), std::move(key));
-        if(offset == root_.free_list)
+        offset = construct_offset_(std::piecewise_construct, std::forward_as_tuple(std::forward<in_key_t>(key)), std::forward_as_tuple(std::forward<args_t>(args)...));
+        set_hash_(offset, hash);
+        link_head_(hash % root_.bucket_count, offset);
+        return std::make_pair(offset, true);
+    }
+    //as try_insert_value_, proc() runs only when the key is absent and the mapped value is constructed from its result
+    template<class in_key_t, class proc_t> pair_posi_t try_insert_lazy_(in_key_t &&key, proc_t &proc)
+    {
+        hash_t hash = get_hasher()(key);
+        size_type offset = find_or_grow_(key, hash);
+        if(offset != root_.size)
         {
-            root_.free_list = root_.index[offset].next;
-            --root_.free_count;
+            return std::make_pair(offset, false);
         }
-        else
+        offset = construct_offset_(std::piecewise_construct, std::forward_as_tuple(std::forward<in_key_t>(key)), std::forward_as_tuple(proc()));
+        set_hash_(offset, hash);
+        link_head_(hash % root_.bucket_count, offset);
+        return std::make_pair(offset, true);
+    }
+    //offset of key, or root_.size once there is room for one more element
+    template<class in_key_t> size_type find_or_grow_(in_key_t const &key, hash_t hash)
+    {
+        if(root_.size != 0)
         {
-            ++root_.size;
+            size_type offset = find_value_(key, hash);
+            if(offset != root_.size)
+            {
+                return offset;
+            }
         }
-        root_.index[offset].hash = hash;
-        root_.index[offset].next = root_.bucket[bucket];
-        root_.index[offset].prev = offset_empty;
-        if(root_.bucket[bucket] != offset_empty)
+        check_grow_();
+        return root_.size;
+    }
+
+    template<class ...args_t> pair_posi_t insert_value_hash_(hash_t hash, args_t &&...args)
+    {
+        if(!config_t::unique_type::value)
         {
-            root_.index[root_.bucket[bucket]].prev = offset_type(offset);
+            check_grow_();
         }
-        root_.bucket[bucket] = offset_type(offset);
-        return std::make_pair(offset, true);
+        return insert_value_hash_uncheck_(typename config_t::unique_type(), hash, std::forward<args_t>(args)...);
     }
-    template<class in_t, class ...args_t> typename std::enable_if<!std::is_same<key_type, value_type>::value || std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_uncheck_(std::true_type, in_t &&in, args_t &&...args)
+
+    insert_return_type insert_node_(std::true_type, node_type &node)
     {
-        hash_t hash = get_hasher()(get_key_t()(in, args...));
-        size_type bucket = hash % root_.bucket_count;
-        for(size_type i = root_.bucket[bucket]; i != offset_empty; i = root_.index[i].next)
+        if(node.empty())
         {
-            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), get_key_t()(in, args...)))
-            {
-                return std::make_pair(i, false);
-            }
+            return insert_return_type{end(), false, node_type()};
         }
-        size_type offset = root_.free_list == offset_empty ? root_.size : root_.free_list;
-        construct_one_(root_.value[offset].value(), std::forward<in_t>(in), std::forward<args_t>(args)...);
-        if(offset == root_.free_list)
+        pair_posi_t result = insert_value_hash_(node.hash_, std::move(*node.storage_.value()));
+        if(!result.second)
         {
-            root_.free_list = root_.index[offset].next;
-            --root_.free_count;
+            return insert_return_type{iterator(result.first, this), false, std::move(node)};
         }
-        else
+        node.reset_();
+        return insert_return_type{iterator(result.first, this), true, node_type()};
+    }
+    iterator insert_node_(std::false_type, node_type &node)
+    {
+        if(node.empty())
         {
-            ++root_.size;
+            return end();
         }
-        root_.index[offset].hash = hash;
-        root_.index[offset].next = root_.bucket[bucket];
-        root_.index[offset].prev = offset_empty;
-        if(root_.bucket[bucket] != offset_empty)
+        pair_posi_t result = insert_value_hash_(node.hash_, std::move(*node.storage_.value()));
+        node.reset_();
+        return iterator(result.first, this);
+    }
+
+    //key must be absent and capacity reserved, no chain walk
+    template<class ...args_t> void append_unique_(hash_t hash, args_t &&...args)
+    {
+        size_type offset = construct_offset_(std::forward<args_t>(args)...);
+        set_hash_(offset, hash);
+        link_head_(hash % root_.bucket_count, offset);
+    }
+
+    //new table holding the elements of source whose key is in both this and other
+    contiguous_hash intersect_(contiguous_hash const &other, contiguous_hash const &source) const
+    {
+        contiguous_hash const &small = size() < other.size() ? *this : other;
+        contiguous_hash const &large = size() < other.size() ? other : *this;
+        contiguous_hash result(0, get_hasher(), get_key_equal(), get_allocator());
+        result.reserve(small.size());
+        batch_probe_(small, large, [&](size_type offset, size_type found)
         {
-            root_.index[root_.bucket[bucket]].prev = offset_type(offset);
+            if(found != large.root_.size)
+            {
+                size_type from = &source == &small ? offset : found;
+                result.append_unique_(source.root_.index[from].hash, *source.root_.value[from].value());
+            }
+        });
+        return result;
+    }
+
+    //visit(offset in from, offset in probe or probe.root_.size) for every element of from
+    //a batch first prefetches buckets, then chain heads, then walks the chains
+    template<class visitor_t> static void batch_probe_(contiguous_hash const &from, contiguous_hash const &probe, visitor_t &&visit)
+    {
+        static size_type const batch_size = 16;
+        size_type batch[batch_size];
+        size_type i = 0;
+        while(i < from.root_.size)
+        {
+            size_type count = 0;
+            for(; i < from.root_.size && count < batch_size; ++i)
+            {
+                if(from.root_.index[i].hash)
+                {
+                    batch[count++] = i;
+                    if(probe.root_.size != 0)
+                    {
+                        contiguous_hash_detail::prefetch(probe.root_.bucket + from.root_.index[i].hash % probe.root_.bucket_count);
+                    }
+                }
+            }
+            if(probe.root_.size == 0)
+            {
+                for(size_type j = 0; j < count; ++j)
+                {
+                    visit(batch[j], probe.root_.size);
+                }
+                continue;
+            }
+            for(size_type j = 0; j < count; ++j)
+            {
+                size_type head = probe.root_.bucket[from.root_.index[batch[j]].hash % probe.root_.bucket_count];
+                if(head != offset_empty)
+                {
+                    contiguous_hash_detail::prefetch(probe.root_.index + head);
+                    contiguous_hash_detail::prefetch(probe.root_.value + head);
+                }
+            }
+            for(size_type j = 0; j < count; ++j)
+            {
+                visit(batch[j], probe.find_value_(get_key_t()(*from.root_.value[batch[j]].value()), from.root_.index[batch[j]].hash));
+            }
         }
-        root_.bucket[bucket] = offset_type(offset);
-        return std::make_pair(offset, true);
     }
 
-    template<class in_t, class ...args_t> pair_posi_t insert_value_uncheck_(std::false_type, in_t &&in, args_t &&...args)
+    //the only place a slot is taken, from free list or the end, ordered mode always takes the end
+    //construct value, hash and links are left to caller
+    template<class ...args_t> size_type construct_offset_(args_t &&...args)
     {
-        size_type offset = root_.free_list == offset_empty ? root_.size : root_.free_list;
-        construct_one_(root_.value[offset].value(), std::forward<in_t>(in), std::forward<args_t>(args)...);
+        size_type offset = ordered_select_t::value || root_.free_list == offset_empty ? root_.size : root_.free_list;
+        construct_one_(root_.value[offset].value(), std::forward<args_t>(args)...);
         if(offset == root_.free_list)
         {
             root_.free_list = root_.index[offset].next;
@@ -1315,58 +2800,89 @@ protected:
         {
             ++root_.size;
         }
-        hash_t hash = get_hasher()(get_key_t()(*root_.value[offset].value()));
-        size_type bucket = hash % root_.bucket_count;
-        size_type where;
-        for(where = root_.bucket[bucket]; where != offset_empty; where = root_.index[where].next)
-        {
-            if(root_.index[where].hash == hash && get_key_equal()(get_key_t()(*root_.value[where].value()), get_key_t()(*root_.value[offset].value())))
-            {
-                break;
-            }
-        }
-        root_.index[offset].hash = hash;
-        if(where == offset_empty)
+        return offset;
+    }
+
+    template<class in_t, class ...args_t> typename std::enable_if<std::is_same<key_type, value_type>::value && !std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_uncheck_(std::true_type, in_t &&in, args_t &&...args)
+    {
+        key_type key = get_key_t()(in, args...);
+        hash_t hash = get_hasher()(key);
+        return insert_value_hash_uncheck_(std::true_type(), hash, std::move(key));
+    }
+    template<class in_t, class ...args_t> typename std::enable_if<!std::is_same<key_type, value_type>::value || std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_uncheck_(std::true_type, in_t &&in, args_t &&...args)
+    {
+        hash_t hash = get_hasher()(get_key_t()(in, args...));
+        return insert_value_hash_uncheck_(std::true_type(), hash, std::forward<in_t>(in), std::forward<args_t>(args)...);
+    }
+    template<class ...args_t> pair_posi_t insert_value_uncheck_(std::false_type, args_t &&...args)
+    {
+        size_type offset = construct_offset_(std::forward<args_t>(args)...);
+        set_hash_(offset, get_hasher()(get_key_t()(*root_.value[offset].value())));
+        link_offset_(std::false_type(), offset);
+        return std::make_pair(offset, true);
+    }
+
+    template<class in_t, class ...args_t> typename std::enable_if<std::is_same<key_type, value_type>::value && !std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_hash_uncheck_(std::true_type, hash_t hash, in_t &&in, args_t &&...args)
+    {
+        return insert_value_hash_uncheck_(std::true_type(), hash, key_type(get_key_t()(in, args...)));
+    }
+    template<class in_t, class ...args_t> typename std::enable_if<!std::is_same<key_type, value_type>::value || std::is_same<typename std::remove_reference<in_t>::type, key_type>::value, pair_posi_t>::type insert_value_hash_uncheck_(std::true_type, hash_t hash, in_t &&in, args_t &&...args)
+    {
+        if(root_.size == 0)
         {
-            root_.index[offset].next = root_.bucket[bucket];
-            root_.index[offset].prev = offset_empty;
-            if(root_.bucket[bucket] != offset_empty)
-            {
-                root_.index[root_.bucket[bucket]].prev = offset_type(offset);
-            }
-            root_.bucket[bucket] = offset_type(offset);
+            check_grow_();
         }
-        else
+        size_type offset = find_value_(get_key_t()(in, args...), hash);
+        if(offset != root_.size)
         {
-            root_.index[offset].next = root_.index[where].next;
-            root_.index[offset].prev = offset_type(where);
-            root_.index[where].next = offset_type(offset);
-            if(root_.index[offset].next != offset_empty)
-            {
-                root_.index[root_.index[offset].next].prev = offset_type(offset);
-            }
+            return std::make_pair(offset, false);
         }
+        check_grow_();
+        offset = construct_offset_(std::forward<in_t>(in), std::forward<args_t>(args)...);
+        set_hash_(offset, hash);
+        link_head_(hash % root_.bucket_count, offset);
+        return std::make_pair(offset, true);
+    }
+    template<class ...args_t> pair_posi_t insert_value_hash_uncheck_(std::false_type, hash_t hash, args_t &&...args)
+    {
+        size_type offset = construct_offset_(std::forward<args_t>(args)...);
+        set_hash_(offset, hash);
+        link_offset_(std::false_type(), offset);
         return std::make_pair(offset, true);
     }
 
     template<class in_key_t> size_type find_value_(in_key_t const &key) const
     {
-        hash_t hash = get_hasher()(key);
-        size_type bucket = hash % root_.bucket_count;
+        return find_value_(key, get_hasher()(key));
+    }
 
-        for(size_type i = root_.bucket[bucket]; i != offset_empty; i = root_.index[i].next)
+    //the one chain walk of every lookup, root_.size if missing
+    template<class in_key_t> size_type find_value_(in_key_t const &key, hash_t hash) const
+    {
+        size_type probe = 0, compare = 0;
+        if(get_bloom_().may_contain(hash.hash))
         {
-            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), key))
+            for(size_type i = root_.bucket[hash % root_.bucket_count]; i != offset_empty; i = root_.index[i].next)
             {
-                return i;
+                ++probe;
+                if(root_.index[i].hash == hash)
+                {
+                    ++compare;
+                    if(get_key_equal()(get_key_t()(*root_.value[i].value()), key))
+                    {
+                        status_control_t::lookup(root_, probe, compare, true);
+                        return i;
+                    }
+                }
             }
         }
+        status_control_t::lookup(root_, probe, compare, false);
         return root_.size;
     }
 
-    size_type remove_value_(std::true_type, key_type const &key)
+    size_type remove_value_(std::true_type, key_type const &key, hash_t hash)
     {
-        size_type offset = find_value_(key);
+        size_type offset = find_value_(key, hash);
         if(offset != root_.size)
         {
             remove_offset_(offset);
@@ -1378,12 +2894,11 @@ protected:
         }
     }
 
-    size_type remove_value_(std::false_type, key_type const &key)
+    size_type remove_value_(std::false_type, key_type const &key, hash_t hash)
     {
-        size_type offset = find_value_(key);
+        size_type offset = find_value_(key, hash);
         if(offset != root_.size)
         {
-            hash_t hash = root_.index[offset].hash;
             size_type count = 1;
             while(true)
             {
@@ -1426,3 +2941,4 @@ protected:
     }
 
 };
+template<class config_t> constexpr typename contiguous_hash<config_t>::offset_type contiguous_hash<config_t>::offset_empty;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "chash_map.h"
+#include "chash_set.h"
+
+
+//approximate membership, no false negatives, about 1% false positives at the sized count
+//one cache line per query, hashes with the same hasher a chash would use
+template<class key_t, class hasher_t = std::hash<key_t>>
+class blocked_bloom_filter
+{
+public:
+    typedef key_t key_type;
+    typedef hasher_t hasher;
+    typedef std::size_t size_type;
+    typedef decltype(std::declval<hasher const &>()(std::declval<key_type const &>())) hash_value_type;
+
+public:
+    explicit blocked_bloom_filter(size_type count = 0, hasher const &hash = hasher()) : hash_(hash)
+    {
+        filter_.reset(count);
+    }
+
+    hasher hash_function() const
+    {
+        return hash_;
+    }
+
+    void insert(key_type const &key)
+    {
+        filter_.insert(std::uint64_t(hash_(key)));
+    }
+    //hash must be hash_function()(key)
+    void insert_hash(hash_value_type hash)
+    {
+        filter_.insert(std::uint64_t(hash));
+    }
+    //false means key was never inserted
+    bool may_contain(key_type const &key) const
+    {
+        return filter_.may_contain(std::uint64_t(hash_(key)));
+    }
+    //hash must be hash_function()(key)
+    bool may_contain_hash(hash_value_type hash) const
+    {
+        return filter_.may_contain(std::uint64_t(hash));
+    }
+
+    //resize for count keys, all keys are forgotten
+    void reset(size_type count)
+    {
+        filter_.reset(count);
+    }
+    void clear()
+    {
+        filter_.clear();
+    }
+    size_type block_count() const
+    {
+        return filter_.block_count();
+    }
+
+protected:
+    hasher hash_;
+    contiguous_hash_detail::blocked_bloom_t filter_;
+};
+
+//chash with a blocked bloom filter in front of the buckets
+//inserts feed the filter, rehash and shrink_to_fit rebuild it, erase leaves stale bits until the next rebuild
+//find/count/erase reject most missing keys without touching bucket or index
+template<class base_config_t>
+struct chash_bloom_config_t : public base_config_t
+{
+    typedef std::true_type bloom_type;
+};
+
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_bloom_map = contiguous_hash<chash_bloom_config_t<chash_map_config_t<key_t, value_t, std::true_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_bloom_multimap = contiguous_hash<chash_bloom_config_t<chash_map_config_t<key_t, value_t, std::false_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_bloom_set = contiguous_hash<chash_bloom_config_t<chash_set_config_t<key_t, std::true_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_bloom_multiset = contiguous_hash<chash_bloom_config_t<chash_set_config_t<key_t, std::false_type, hasher_t, key_equal_t, allocator_t>>>;
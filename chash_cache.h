@@ -0,0 +1,328 @@
+#pragma once
+
+#include "chash_map.h"
+
+#include <functional>
+
+
+//evict the least recently used entry, a hit relinks the entry to the front
+struct chash_cache_lru
+{
+};
+//evict the first unreferenced entry found by a hand sweeping the slot array, a hit only sets a bit
+//new entries start unreferenced, so one pass scans do not flush entries that were hit
+struct chash_cache_clock
+{
+};
+
+namespace chash_cache_detail
+{
+    struct construct_tag_t
+    {
+    };
+
+    template<class value_t, class offset_t, class policy_t> struct node_t;
+    template<class value_t, class offset_t> struct node_t<value_t, offset_t, chash_cache_lru>
+    {
+        template<class ...args_t> node_t(construct_tag_t, args_t &&...args) : value(std::forward<args_t>(args)...)
+        {
+        }
+        value_t value;
+        offset_t prev;
+        offset_t next;
+    };
+    template<class value_t, class offset_t> struct node_t<value_t, offset_t, chash_cache_clock>
+    {
+        template<class ...args_t> node_t(construct_tag_t, args_t &&...args) : value(std::forward<args_t>(args)...), referenced(false)
+        {
+        }
+        value_t value;
+        bool referenced;
+    };
+
+    //a cache never holds more than 2^32 - 2 entries, 32 bit offsets keep the bucket, index and recency links small
+    template<class key_t, class value_t, class hasher_t, class key_equal_t, class allocator_t>
+    struct config_t : public chash_map_config_t<key_t, value_t, std::true_type, hasher_t, key_equal_t, allocator_t>
+    {
+        typedef std::uint32_t offset_type;
+    };
+}
+
+//fixed capacity cache, entries live in the slots of a contiguous_hash reserved once
+//slot offsets never move, recency links are slot offsets, no allocation per entry
+template<class key_t, class value_t, class policy_t = chash_cache_lru, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+class chash_cache : protected contiguous_hash<chash_cache_detail::config_t<key_t, chash_cache_detail::node_t<value_t, std::uint32_t, policy_t>, hasher_t, key_equal_t, typename std::allocator_traits<allocator_t>::template rebind_alloc<std::pair<key_t const, chash_cache_detail::node_t<value_t, std::uint32_t, policy_t>>>>>
+{
+public:
+    typedef key_t key_type;
+    typedef value_t mapped_type;
+    typedef policy_t policy_type;
+    typedef hasher_t hasher;
+    typedef key_equal_t key_equal;
+    typedef allocator_t allocator_type;
+    typedef std::function<void(key_type const &, mapped_type &)> evict_callback_t;
+
+protected:
+    typedef chash_cache_detail::node_t<mapped_type, std::uint32_t, policy_type> node_t;
+    typedef contiguous_hash<chash_cache_detail::config_t<key_type, node_t, hasher, key_equal, typename std::allocator_traits<allocator_type>::template rebind_alloc<std::pair<key_type const, node_t>>>> base_t;
+    typedef typename base_t::hash_t hash_t;
+    typedef typename base_t::offset_type offset_type;
+    using base_t::offset_empty;
+    using base_t::root_;
+
+public:
+    typedef typename base_t::size_type size_type;
+    typedef typename base_t::hash_value_type hash_value_type;
+
+public:
+    //capacity is at least 1 and at most 2^32 - 2, on_evict(key, value) runs before an entry is dropped to make room
+    explicit chash_cache(size_type capacity, evict_callback_t on_evict = evict_callback_t(), hasher const &hash = hasher(), key_equal const &equal = key_equal(), allocator_type const &alloc = allocator_type()) : base_t(0, hash, equal, typename base_t::allocator_type(alloc)), capacity_(std::min<size_type>(std::max<size_type>(capacity, 1), base_t::offset_empty - 1)), on_evict_(std::move(on_evict))
+    {
+        base_t::reserve(capacity_);
+        reset_();
+    }
+    chash_cache(chash_cache const &) = delete;
+    chash_cache &operator = (chash_cache const &) = delete;
+
+    using base_t::hash_function;
+    using base_t::key_eq;
+    using base_t::size;
+    using base_t::empty;
+
+    size_type capacity() const
+    {
+        return capacity_;
+    }
+    void set_evict_callback(evict_callback_t on_evict)
+    {
+        on_evict_ = std::move(on_evict);
+    }
+
+    //hit marks the entry recently used, nullptr if missing
+    template<class in_key_t> mapped_type *find(in_key_t const &key)
+    {
+        size_type offset = base_t::find_value_(key);
+        if(offset == root_.size)
+        {
+            return nullptr;
+        }
+        touch_(offset, policy_type());
+        return &node_(offset).value;
+    }
+    //no promotion
+    template<class in_key_t> mapped_type const *peek(in_key_t const &key) const
+    {
+        size_type offset = base_t::find_value_(key);
+        if(offset == root_.size)
+        {
+            return nullptr;
+        }
+        return &node_(offset).value;
+    }
+    template<class in_key_t> bool contains(in_key_t const &key) const
+    {
+        return base_t::find_value_(key) != root_.size;
+    }
+
+    //mapped_type constructed from args only if key is absent, evicts when full, the entry is marked recently used
+    template<class in_key_t, class ...args_t> std::pair<mapped_type *, bool> try_emplace(in_key_t &&key, args_t &&...args)
+    {
+        hash_t hash = base_t::get_hasher()(key);
+        size_type offset = base_t::find_value_(key, hash);
+        if(offset != root_.size)
+        {
+            touch_(offset, policy_type());
+            return std::make_pair(&node_(offset).value, false);
+        }
+        offset = insert_(hash, std::forward<in_key_t>(key), std::forward<args_t>(args)...);
+        return std::make_pair(&node_(offset).value, true);
+    }
+    template<class in_key_t, class in_mapped_t> std::pair<mapped_type *, bool> insert_or_assign(in_key_t &&key, in_mapped_t &&mapped)
+    {
+        std::pair<mapped_type *, bool> result = try_emplace(std::forward<in_key_t>(key), std::forward<in_mapped_t>(mapped));
+        if(!result.second)
+        {
+            *result.first = std::forward<in_mapped_t>(mapped);
+        }
+        return result;
+    }
+    //on miss the value is constructed from load(), read through cache in one probe
+    template<class in_key_t, class load_t> mapped_type &fetch(in_key_t &&key, load_t &&load)
+    {
+        hash_t hash = base_t::get_hasher()(key);
+        size_type offset = base_t::find_value_(key, hash);
+        if(offset != root_.size)
+        {
+            touch_(offset, policy_type());
+            return node_(offset).value;
+        }
+        return node_(insert_(hash, std::forward<in_key_t>(key), load())).value;
+    }
+
+    //no eviction callback
+    bool erase(key_type const &key)
+    {
+        size_type offset = base_t::find_value_(key);
+        if(offset == root_.size)
+        {
+            return false;
+        }
+        detach_(offset, policy_type());
+        base_t::remove_offset_(offset);
+        return true;
+    }
+    //no eviction callback, capacity is kept
+    void clear()
+    {
+        base_t::clear();
+        reset_();
+    }
+
+    //visit(key_type const &, mapped_type &) in slot order
+    template<class visitor_t> void for_each(visitor_t &&visit)
+    {
+        for(size_type i = 0; i < root_.size; ++i)
+        {
+            if(root_.index[i].hash)
+            {
+                auto &value = *root_.value[i].value();
+                visit(value.first, value.second.value);
+            }
+        }
+    }
+
+protected:
+    size_type capacity_;
+    evict_callback_t on_evict_;
+    //lru : most and least recently used, clock : hand
+    size_type head_;
+    size_type tail_;
+    size_type hand_;
+
+protected:
+    node_t &node_(size_type offset)
+    {
+        return root_.value[offset].value()->second;
+    }
+    node_t const &node_(size_type offset) const
+    {
+        return root_.value[offset].value()->second;
+    }
+
+    void reset_()
+    {
+        head_ = offset_empty;
+        tail_ = offset_empty;
+        hand_ = 0;
+    }
+
+    template<class in_key_t, class ...args_t> size_type insert_(hash_t hash, in_key_t &&key, args_t &&...args)
+    {
+        if(base_t::size() >= capacity_)
+        {
+            evict_(policy_type());
+        }
+        size_type offset = base_t::construct_offset_(std::piecewise_construct, std::forward_as_tuple(std::forward<in_key_t>(key)), std::forward_as_tuple(chash_cache_detail::construct_tag_t(), std::forward<args_t>(args)...));
+        base_t::set_hash_(offset, hash);
+        base_t::link_head_(hash % root_.bucket_count, offset);
+        attach_(offset, policy_type());
+        return offset;
+    }
+
+    void drop_(size_type offset)
+    {
+        if(on_evict_)
+        {
+            auto &value = *root_.value[offset].value();
+            on_evict_(value.first, value.second.value);
+        }
+        detach_(offset, policy_type());
+        base_t::remove_offset_(offset);
+    }
+
+    void attach_(size_type offset, chash_cache_lru)
+    {
+        node_t &node = node_(offset);
+        node.prev = offset_empty;
+        node.next = offset_type(head_);
+        if(head_ != offset_empty)
+        {
+            node_(head_).prev = offset_type(offset);
+        }
+        else
+        {
+            tail_ = offset;
+        }
+        head_ = offset;
+    }
+    void detach_(size_type offset, chash_cache_lru)
+    {
+        node_t &node = node_(offset);
+        if(node.prev != offset_empty)
+        {
+            node_(node.prev).next = node.next;
+        }
+        else
+        {
+            head_ = node.next;
+        }
+        if(node.next != offset_empty)
+        {
+            node_(node.next).prev = node.prev;
+        }
+        else
+        {
+            tail_ = node.prev;
+        }
+    }
+    void touch_(size_type offset, chash_cache_lru)
+    {
+        if(offset != head_)
+        {
+            detach_(offset, chash_cache_lru());
+            attach_(offset, chash_cache_lru());
+        }
+    }
+    void evict_(chash_cache_lru)
+    {
+        drop_(tail_);
+    }
+
+    void attach_(size_type, chash_cache_clock)
+    {
+    }
+    void detach_(size_type, chash_cache_clock)
+    {
+    }
+    void touch_(size_type offset, chash_cache_clock)
+    {
+        node_(offset).referenced = true;
+    }
+    //called only when full, ends within two sweeps
+    void evict_(chash_cache_clock)
+    {
+        while(true)
+        {
+            if(hand_ >= root_.size)
+            {
+                hand_ = 0;
+            }
+            if(root_.index[hand_].hash)
+            {
+                node_t &node = node_(hand_);
+                if(!node.referenced)
+                {
+                    break;
+                }
+                node.referenced = false;
+            }
+            ++hand_;
+        }
+        drop_(hand_++);
+    }
+};
+
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_lru_cache = chash_cache<key_t, value_t, chash_cache_lru, hasher_t, key_equal_t, allocator_t>;
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_clock_cache = chash_cache<key_t, value_t, chash_cache_clock, hasher_t, key_equal_t, allocator_t>;
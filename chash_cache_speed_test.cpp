@@ -0,0 +1,92 @@
+﻿
+#define _SCL_SECURE_NO_WARNINGS
+
+#include "chash_cache.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <list>
+#include <unordered_map>
+#include <cmath>
+#include <string>
+
+//baseline, std::list for recency plus std::unordered_map
+template<class key_t, class value_t>
+class list_lru_cache
+{
+public:
+    list_lru_cache(size_t capacity) : capacity_(capacity)
+    {
+    }
+    template<class load_t> value_t &fetch(key_t const &key, load_t &&load)
+    {
+        auto where = map_.find(key);
+        if(where != map_.end())
+        {
+            list_.splice(list_.begin(), list_, where->second);
+            return where->second->second;
+        }
+        if(map_.size() >= capacity_)
+        {
+            map_.erase(list_.back().first);
+            list_.pop_back();
+        }
+        list_.emplace_front(key, load());
+        map_.emplace(key, list_.begin());
+        return list_.front().second;
+    }
+private:
+    size_t capacity_;
+    std::list<std::pair<key_t, value_t>> list_;
+    std::unordered_map<key_t, typename std::list<std::pair<key_t, value_t>>::iterator> map_;
+};
+
+int main()
+{
+    auto t = std::chrono::high_resolution_clock::now;
+    std::mt19937 mt(0);
+
+    size_t const capacity = 1 << 16;
+    size_t const universe = 1 << 20;
+    std::vector<int> v;
+    v.resize(20000000);
+    //skewed keys, roughly zipf: small keys are hot
+    auto reset = [&mt, &v, universe](double skew)
+    {
+        std::uniform_real_distribution<double> dist(0, 1);
+        for(auto &value : v)
+        {
+            value = int(std::pow(dist(mt), skew) * universe);
+        }
+    };
+
+    auto test = [&v](auto &c, char const *name)
+    {
+        auto t = std::chrono::high_resolution_clock::now;
+        size_t miss = 0;
+        int64_t sum = 0;
+        auto s = t();
+        for(int key : v)
+        {
+            sum += c.fetch(key, [&miss, key]{ ++miss; return int64_t(key); });
+        }
+        auto e = t();
+        float ms = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(e - s).count();
+        std::cout << name << " hit ratio = " << 1 - double(miss) / v.size() << ", time(ms) = " << ms << ", ops/ms = " << v.size() / ms << (sum == 0 ? " " : "") << std::endl;
+    };
+
+    for(double skew : {1.0, 4.0, 16.0})
+    {
+        reset(skew);
+        std::cout << "skew " << skew << std::endl;
+        chash_lru_cache<int, int64_t> lru(capacity);
+        test(lru, "chash lru  ");
+        chash_clock_cache<int, int64_t> clock(capacity);
+        test(clock, "chash clock");
+        list_lru_cache<int, int64_t> list(capacity);
+        test(list, "list lru   ");
+    }
+
+    v.clear();
+}
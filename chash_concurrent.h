@@ -0,0 +1,235 @@
+#pragma once
+
+#include "chash_map.h"
+#include "chash_set.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+
+template<class config_t, std::size_t shard_bits = 6>
+class sharded_contiguous_hash
+{
+public:
+    typedef contiguous_hash<config_t> shard_type;
+    typedef typename shard_type::key_type key_type;
+    typedef typename shard_type::mapped_type mapped_type;
+    typedef typename shard_type::value_type value_type;
+    typedef typename shard_type::size_type size_type;
+    typedef typename shard_type::hasher hasher;
+    typedef typename shard_type::key_equal key_equal;
+    typedef typename shard_type::allocator_type allocator_type;
+    typedef typename shard_type::hash_value_type hash_value_type;
+
+    static constexpr size_type shard_count = size_type(1) << shard_bits;
+
+protected:
+    typedef std::shared_timed_mutex mutex_t;
+    typedef std::shared_lock<mutex_t> read_lock_t;
+    typedef std::unique_lock<mutex_t> write_lock_t;
+    struct shard_t
+    {
+        shard_t(size_type bucket_count, hasher const &hash, key_equal const &equal, allocator_type const &alloc) : table(bucket_count, hash, equal, alloc)
+        {
+        }
+        mutable mutex_t lock;
+        shard_type table;
+    };
+
+public:
+    explicit sharded_contiguous_hash(size_type bucket_count = 0, hasher const &hash = hasher(), key_equal const &equal = key_equal(), allocator_type const &alloc = allocator_type()) : hash_(hash)
+    {
+        static_assert(shard_bits > 0 && shard_bits < 16, "shard_bits out of range");
+        shard_.reserve(shard_count);
+        for(size_type i = 0; i < shard_count; ++i)
+        {
+            shard_.emplace_back(new shard_t(bucket_count / shard_count, hash, equal, alloc));
+        }
+    }
+    sharded_contiguous_hash(sharded_contiguous_hash const &) = delete;
+    sharded_contiguous_hash &operator = (sharded_contiguous_hash const &) = delete;
+
+    hasher hash_function() const
+    {
+        return hash_;
+    }
+
+    //visit(value_type const &) under shared lock, return false if not found
+    template<class in_key_t, class visitor_t> bool find(in_key_t const &key, visitor_t &&visit) const
+    {
+        hash_value_type hash = hash_(key);
+        shard_t &shard = get_shard_(hash);
+        read_lock_t lock(shard.lock);
+        auto where = shard.table.find(key, hash);
+        if(where == shard.table.end())
+        {
+            return false;
+        }
+        visit(*where);
+        return true;
+    }
+    //visit(value_type &) under exclusive lock, return false if not found
+    template<class in_key_t, class visitor_t> bool update(in_key_t const &key, visitor_t &&visit)
+    {
+        hash_value_type hash = hash_(key);
+        shard_t &shard = get_shard_(hash);
+        write_lock_t lock(shard.lock);
+        auto where = shard.table.find(key, hash);
+        if(where == shard.table.end())
+        {
+            return false;
+        }
+        visit(*where);
+        return true;
+    }
+    template<class in_key_t> bool contains(in_key_t const &key) const
+    {
+        hash_value_type hash = hash_(key);
+        shard_t &shard = get_shard_(hash);
+        read_lock_t lock(shard.lock);
+        return shard.table.find(key, hash) != shard.table.end();
+    }
+
+    //return true if inserted
+    bool insert(value_type const &value)
+    {
+        hash_value_type hash = hash_(config_t::get_key(value));
+        shard_t &shard = get_shard_(hash);
+        write_lock_t lock(shard.lock);
+        return insert_result_(shard.table.emplace_with_hash(hash, value));
+    }
+    //return true if inserted
+    bool insert(value_type &&value)
+    {
+        hash_value_type hash = hash_(config_t::get_key(value));
+        shard_t &shard = get_shard_(hash);
+        write_lock_t lock(shard.lock);
+        return insert_result_(shard.table.emplace_with_hash(hash, std::move(value)));
+    }
+    //insert value if key absent, else update(value_type &) under the same lock, return true if inserted
+    template<class in_value_t, class updater_t> bool upsert(in_value_t &&value, updater_t &&update)
+    {
+        hash_value_type hash = hash_(config_t::get_key(value));
+        shard_t &shard = get_shard_(hash);
+        write_lock_t lock(shard.lock);
+        auto where = shard.table.find(config_t::get_key(value), hash);
+        if(where != shard.table.end())
+        {
+            update(*where);
+            return false;
+        }
+        shard.table.emplace_with_hash(hash, std::forward<in_value_t>(value));
+        return true;
+    }
+
+    template<class in_key_t> size_type erase(in_key_t const &key)
+    {
+        hash_value_type hash = hash_(key);
+        shard_t &shard = get_shard_(hash);
+        write_lock_t lock(shard.lock);
+        return shard.table.erase(key, hash);
+    }
+
+    //visit(value_type const &) for every element, one shared lock per shard, shards split across threads
+    template<class visitor_t> void for_each(visitor_t &&visit, size_type thread_count = 1) const
+    {
+        for_each_shard_(thread_count, [&visit](shard_t &shard)
+        {
+            read_lock_t lock(shard.lock);
+            shard_type const &table = shard.table;
+            for(auto &value : table)
+            {
+                visit(value);
+            }
+        });
+    }
+    //visit(value_type &) for every element, one exclusive lock per shard, shards split across threads
+    template<class visitor_t> void for_each(visitor_t &&visit, size_type thread_count = 1)
+    {
+        for_each_shard_(thread_count, [&visit](shard_t &shard)
+        {
+            write_lock_t lock(shard.lock);
+            for(auto &value : shard.table)
+            {
+                visit(value);
+            }
+        });
+    }
+
+    //not a snapshot, shards are counted one by one
+    size_type size() const
+    {
+        size_type count = 0;
+        for(auto &shard : shard_)
+        {
+            read_lock_t lock(shard->lock);
+            count += shard->table.size();
+        }
+        return count;
+    }
+    bool empty() const
+    {
+        return size() == 0;
+    }
+    void clear()
+    {
+        for(auto &shard : shard_)
+        {
+            write_lock_t lock(shard->lock);
+            shard->table.clear();
+        }
+    }
+    void reserve(size_type count)
+    {
+        for(auto &shard : shard_)
+        {
+            write_lock_t lock(shard->lock);
+            shard->table.reserve(count / shard_count + 1);
+        }
+    }
+
+protected:
+    hasher hash_;
+    std::vector<std::unique_ptr<shard_t>> shard_;
+
+protected:
+    static bool insert_result_(std::pair<typename shard_type::iterator, bool> const &result)
+    {
+        return result.second;
+    }
+    static bool insert_result_(typename shard_type::iterator const &)
+    {
+        return true;
+    }
+
+    //high bits of a fibonacci mix, independent from the prime modulo used inside each shard
+    static size_type shard_index_(hash_value_type hash)
+    {
+        return size_type((std::uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> (64 - shard_bits));
+    }
+
+    //key is hashed once by the caller, the same hash goes to the shard table
+    shard_t &get_shard_(hash_value_type hash) const
+    {
+        return *shard_[shard_index_(hash)];
+    }
+
+    template<class shard_proc_t> void for_each_shard_(size_type thread_count, shard_proc_t const &proc) const
+    {
+        thread_count = std::max<size_type>(1, std::min(thread_count, shard_count));
+        contiguous_hash_detail::parallel_for(thread_count, [this, thread_count, &proc](size_type t)
+        {
+            for(size_type i = t; i < shard_count; i += thread_count)
+            {
+                proc(*shard_[i]);
+            }
+        });
+    }
+};
+template<class config_t, std::size_t shard_bits> constexpr typename sharded_contiguous_hash<config_t, shard_bits>::size_type sharded_contiguous_hash<config_t, shard_bits>::shard_count;
+
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_concurrent_map = sharded_contiguous_hash<chash_map_config_t<key_t, value_t, std::true_type, hasher_t, key_equal_t, allocator_t>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_concurrent_set = sharded_contiguous_hash<chash_set_config_t<key_t, std::true_type, hasher_t, key_equal_t, allocator_t>>;
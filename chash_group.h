@@ -0,0 +1,244 @@
+#pragma once
+
+#include "chash_map.h"
+
+#include <vector>
+
+
+//multimap keeping all values of one key in one contiguous run
+//equal_range returns a span over the run, fan out reads are sequential scans
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<value_t>>
+class chash_group_multimap
+{
+public:
+    typedef key_t key_type;
+    typedef value_t mapped_type;
+    typedef hasher_t hasher;
+    typedef key_equal_t key_equal;
+    typedef allocator_t allocator_type;
+    typedef std::vector<mapped_type, typename std::allocator_traits<allocator_type>::template rebind_alloc<mapped_type>> group_type;
+    typedef chash_map<key_type, group_type, hasher, key_equal, typename std::allocator_traits<allocator_type>::template rebind_alloc<std::pair<key_type const, group_type>>> table_type;
+    typedef typename table_type::size_type size_type;
+    typedef typename table_type::hash_value_type hash_value_type;
+    //groups are read only through iterators, size() counts their values
+    typedef typename table_type::const_iterator iterator;
+    typedef typename table_type::const_iterator const_iterator;
+
+    //[begin, end) of one group, invalidated when the group grows or the table reallocates
+    template<class pointer_t> class span_t
+    {
+    public:
+        span_t() : begin_(nullptr), end_(nullptr)
+        {
+        }
+        span_t(pointer_t _begin, pointer_t _end) : begin_(_begin), end_(_end)
+        {
+        }
+        pointer_t begin() const
+        {
+            return begin_;
+        }
+        pointer_t end() const
+        {
+            return end_;
+        }
+        pointer_t data() const
+        {
+            return begin_;
+        }
+        size_type size() const
+        {
+            return size_type(end_ - begin_);
+        }
+        bool empty() const
+        {
+            return begin_ == end_;
+        }
+        decltype(*pointer_t()) operator[](size_type index) const
+        {
+            return begin_[index];
+        }
+    private:
+        pointer_t begin_;
+        pointer_t end_;
+    };
+    typedef span_t<mapped_type *> range_type;
+    typedef span_t<mapped_type const *> const_range_type;
+
+public:
+    explicit chash_group_multimap(size_type bucket_count = 0, hasher const &hash = hasher(), key_equal const &equal = key_equal(), allocator_type const &alloc = allocator_type()) : table_(bucket_count, hash, equal, typename table_type::allocator_type(alloc)), size_(0)
+    {
+    }
+
+    hasher hash_function() const
+    {
+        return table_.hash_function();
+    }
+    key_equal key_eq() const
+    {
+        return table_.key_eq();
+    }
+
+    //append to the group of key, one probe for the key, a new key keeps no group if the value throws
+    template<class in_key_t, class ...args_t> mapped_type &emplace(in_key_t &&key, args_t &&...args)
+    {
+        auto where = table_.try_emplace(std::forward<in_key_t>(key)).first;
+        try
+        {
+            where->second.emplace_back(std::forward<args_t>(args)...);
+        }
+        catch(...)
+        {
+            drop_empty_(where);
+            throw;
+        }
+        ++size_;
+        return where->second.back();
+    }
+    mapped_type &insert(std::pair<key_type, mapped_type> const &value)
+    {
+        return emplace(value.first, value.second);
+    }
+    mapped_type &insert(std::pair<key_type, mapped_type> &&value)
+    {
+        return emplace(std::move(value.first), std::move(value.second));
+    }
+    //append [begin, end) to the group of key, an empty range does not create a group
+    template<class in_key_t, class iterator_t> void insert(in_key_t &&key, iterator_t begin, iterator_t end)
+    {
+        if(begin == end)
+        {
+            return;
+        }
+        auto where = table_.try_emplace(std::forward<in_key_t>(key)).first;
+        size_type old_size = where->second.size();
+        try
+        {
+            where->second.insert(where->second.end(), begin, end);
+        }
+        catch(...)
+        {
+            size_ += where->second.size() - old_size;
+            drop_empty_(where);
+            throw;
+        }
+        size_ += where->second.size() - old_size;
+    }
+
+    template<class in_key_t> range_type equal_range(in_key_t const &key)
+    {
+        auto where = table_.find(key);
+        if(where == table_.end())
+        {
+            return range_type();
+        }
+        return range_type(where->second.data(), where->second.data() + where->second.size());
+    }
+    template<class in_key_t> const_range_type equal_range(in_key_t const &key) const
+    {
+        auto where = table_.find(key);
+        if(where == table_.end())
+        {
+            return const_range_type();
+        }
+        return const_range_type(where->second.data(), where->second.data() + where->second.size());
+    }
+    template<class in_key_t> size_type count(in_key_t const &key) const
+    {
+        auto where = table_.find(key);
+        return where == table_.end() ? 0 : where->second.size();
+    }
+
+    //iterate groups, value_type is pair<key_type const, group_type>
+    template<class in_key_t> const_iterator find(in_key_t const &key) const
+    {
+        return table_.find(key);
+    }
+    const_iterator begin() const
+    {
+        return table_.begin();
+    }
+    const_iterator end() const
+    {
+        return table_.end();
+    }
+
+    //remove the whole group, return count of values removed
+    size_type erase(key_type const &key)
+    {
+        auto where = table_.find(key);
+        if(where == table_.end())
+        {
+            return 0;
+        }
+        size_type count = where->second.size();
+        table_.erase(where);
+        size_ -= count;
+        return count;
+    }
+    //remove values matching pred(mapped_type const &) from the group, keeps order, drops the group if it becomes empty
+    template<class pred_t> size_type erase(key_type const &key, pred_t &&pred)
+    {
+        auto where = table_.find(key);
+        if(where == table_.end())
+        {
+            return 0;
+        }
+        group_type &group = where->second;
+        size_type old_size = group.size();
+        group.erase(std::remove_if(group.begin(), group.end(), pred), group.end());
+        size_type count = old_size - group.size();
+        size_ -= count;
+        if(group.empty())
+        {
+            table_.erase(where);
+        }
+        return count;
+    }
+
+    //count of values
+    size_type size() const
+    {
+        return size_;
+    }
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+    //count of distinct keys
+    size_type group_count() const
+    {
+        return table_.size();
+    }
+    void reserve(size_type group_count)
+    {
+        table_.reserve(group_count);
+    }
+    void clear()
+    {
+        table_.clear();
+        size_ = 0;
+    }
+    void shrink_to_fit()
+    {
+        for(auto &value : table_)
+        {
+            value.second.shrink_to_fit();
+        }
+        table_.shrink_to_fit();
+    }
+
+protected:
+    table_type table_;
+    size_type size_;
+
+protected:
+    //every group holds at least one value
+    void drop_empty_(typename table_type::iterator where)
+    {
+        if(where->second.empty())
+        {
+            table_.erase(where);
+        }
+    }
+};
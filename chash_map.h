@@ -15,6 +15,7 @@ struct chash_map_config_t
     typedef std::uintptr_t offset_type;
     typedef typename std::result_of<hasher(key_type)>::type hash_value_type;
     typedef unique_t unique_type;
+    typedef std::false_type status_type;
     static float grow_proportion(std::size_t)
     {
         return 2;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "chash_map.h"
+#include "chash_set.h"
+
+
+//chash iterating in insertion order, inserts always append after the last slot
+//erase leaves a hole that is skipped, holes are reclaimed only by compaction which keeps the order
+//compaction runs on shrink_to_fit, on an insert past compact_proportion, and always on a grow when half of the slots are holes
+//slot_id / at_slot stay valid until compaction
+template<class base_config_t>
+struct chash_ordered_config_t : public base_config_t
+{
+    typedef std::true_type ordered_type;
+};
+
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_ordered_map = contiguous_hash<chash_ordered_config_t<chash_map_config_t<key_t, value_t, std::true_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_ordered_multimap = contiguous_hash<chash_ordered_config_t<chash_map_config_t<key_t, value_t, std::false_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_ordered_set = contiguous_hash<chash_ordered_config_t<chash_set_config_t<key_t, std::true_type, hasher_t, key_equal_t, allocator_t>>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_ordered_multiset = contiguous_hash<chash_ordered_config_t<chash_set_config_t<key_t, std::false_type, hasher_t, key_equal_t, allocator_t>>>;
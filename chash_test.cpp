@@ -3,14 +3,25 @@
 
 #include "chash_map.h"
 #include "chash_set.h"
+#include "chash_concurrent.h"
+#include "chash_view.h"
+#include "chash_group.h"
+#include "chash_cache.h"
+#include "chash_bloom.h"
+#include "chash_ordered.h"
+#include "huge_page_allocator.h"
 
 #include <chrono>
+#include <cstddef>
+#include <fstream>
 #include <iostream>
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
 #include <cstring>
 #include <string>
+#include <thread>
+#include <atomic>
 
 
 #define assert(exp) assert_proc(exp, #exp, __FILE__, __LINE__)
@@ -37,6 +48,19 @@ auto assert_proc = [](bool no_error, char const *query, char const *file, size_t
     }
 };
 
+//constructs from anything, upsert must not hand it a helper object in place of the value
+struct greedy_mapped
+{
+    greedy_mapped(int _value = 0) : value(_value)
+    {
+    }
+    greedy_mapped(greedy_mapped &&) = default;
+    template<class in_t> greedy_mapped(in_t &&) : value(-1)
+    {
+    }
+    int value;
+};
+
 int main()
 {
     [&]
@@ -48,6 +72,843 @@ int main()
         auto range = ch.equal_range(3);
         assert(std::distance(range.first, range.second) == 4);
     }();
+    [&]
+    {
+        chash_concurrent_map<int, int> cm;
+        std::vector<std::thread> thread;
+        for(int t = 0; t < 4; ++t)
+        {
+            thread.emplace_back([&cm, t]
+            {
+                for(int i = 0; i < 10000; ++i)
+                {
+                    cm.insert(std::make_pair(i * 4 + t, i));
+                    cm.upsert(std::make_pair(-1, 1), [](std::pair<int const, int> &value)
+                    {
+                        ++value.second;
+                    });
+                }
+            });
+        }
+        for(auto &item : thread)
+        {
+            item.join();
+        }
+        assert(cm.size() == 40001);
+        assert(cm.find(-1, [](std::pair<int const, int> const &value)
+        {
+            assert(value.second == 40000);
+        }));
+        assert(cm.erase(-1) == 1);
+        assert(!cm.contains(-1));
+        std::atomic<long long> sum(0);
+        cm.for_each([&sum](std::pair<int const, int> const &value)
+        {
+            sum += value.first;
+        }, 4);
+        assert(sum == 40000ll * 39999 / 2);
+    }();
+    [&]
+    {
+        chash_map<int, int> ch;
+        for(int i = 0; i < 1000; ++i)
+        {
+            ch.emplace(i, i * 2);
+        }
+        for(int i = 0; i < 1000; i += 3)
+        {
+            ch.erase(i);
+        }
+        ch.save("chash_view_test.bin");
+        {
+            auto view = chash_map_view<int, int>::open("chash_view_test.bin");
+            assert(view.size() == ch.size());
+            assert(view.find(0) == view.end());
+            assert(view.find(1)->second == 2);
+            assert(view.count(998) == 1);
+            assert(view.count(999) == 0);
+            int count = 0;
+            for(auto &value : view)
+            {
+                assert(ch.at(value.first) == value.second);
+                ++count;
+            }
+            assert(count == int(ch.size()));
+        }
+        std::vector<char> image;
+        {
+            std::ifstream in("chash_view_test.bin", std::ios::binary);
+            image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        typedef contiguous_hash_detail::image_header_t header_t;
+        std::uint64_t const bad_position[] = {image.size(), image.size() - 4, std::uint64_t(-8), 1};
+        for(size_t field : {offsetof(header_t, bucket_position), offsetof(header_t, index_position), offsetof(header_t, value_position)})
+        {
+            for(std::uint64_t position : bad_position)
+            {
+                std::vector<char> bad = image;
+                std::memcpy(bad.data() + field, &position, sizeof position);
+                std::ofstream("chash_view_test.bin", std::ios::binary).write(bad.data(), std::streamsize(bad.size()));
+                bool thrown = false;
+                try
+                {
+                    chash_map_view<int, int>::open("chash_view_test.bin");
+                }
+                catch(std::runtime_error const &)
+                {
+                    thrown = true;
+                }
+                assert(thrown);
+            }
+        }
+        header_t header;
+        std::memcpy(&header, image.data(), sizeof header);
+        typedef chash_map_view<int, int>::offset_type offset_type;
+        for(int loop = 0; loop < 2; ++loop)
+        {
+            std::vector<char> bad = image;
+            for(std::uint64_t i = 0; loop == 0 && i < header.bucket_count; ++i)
+            {
+                offset_type past = offset_type(header.size + i % 7);
+                std::memcpy(bad.data() + header.bucket_position + i * sizeof past, &past, sizeof past);
+            }
+            for(std::uint64_t i = 0; loop == 1 && i < header.size; ++i)
+            {
+                offset_type self = offset_type(i);
+                std::memcpy(bad.data() + header.index_position + i * header.index_size + header.index_size - 2 * sizeof self, &self, sizeof self);
+            }
+            std::ofstream("chash_view_test.bin", std::ios::binary).write(bad.data(), std::streamsize(bad.size()));
+            auto view = chash_map_view<int, int>::open("chash_view_test.bin");
+            size_t thrown = 0;
+            for(int i = 0; i < 1000; ++i)
+            {
+                try
+                {
+                    view.count(i);
+                }
+                catch(std::runtime_error const &)
+                {
+                    ++thrown;
+                }
+            }
+            assert(loop == 0 ? thrown == 1000 : thrown >= ch.size());
+        }
+        std::remove("chash_view_test.bin");
+    }();
+    [&]
+    {
+        std::vector<int> data;
+        for(int i = 0; i < 100000; ++i)
+        {
+            data.push_back(i % 30000);
+        }
+        chash_set<int> set;
+        set.build(data.begin(), data.end(), 4);
+        assert(set.size() == 30000);
+        assert(set.count(29999) == 1);
+        assert(set.count(30000) == 0);
+        chash_multiset<int> mset;
+        mset.build(data.begin(), data.end(), 4);
+        assert(mset.size() == 100000);
+        auto range = mset.equal_range(5);
+        assert(std::distance(range.first, range.second) == 4);
+        mset.rehash(300000, 4);
+        range = mset.equal_range(29999);
+        assert(std::distance(range.first, range.second) == 3);
+        set.rehash(100000, 4);
+        for(int i = 0; i < 30000; ++i)
+        {
+            assert(set.find(i) != set.end());
+        }
+        set.insert(30000);
+        assert(set.size() == 30001);
+    }();
+    [&]
+    {
+        chash_map<std::string, std::string> ch;
+        for(int i = 0; i < 10000; ++i)
+        {
+            ch.emplace(std::to_string(i), std::to_string(i * 2));
+        }
+        size_t bucket_count = ch.bucket_count();
+        auto kept = ch.find("9900");
+        for(int i = 0; i < 10000; ++i)
+        {
+            if(i % 100 != 0)
+            {
+                ch.erase(std::to_string(i));
+            }
+        }
+        assert(kept == ch.find("9900") && kept->second == "19800" && ch.slot_count() == 10000);
+        ch.emplace("-1", "-2");
+        assert(ch.size() == 101 && ch.slot_count() == 101);
+        assert(ch.bucket_count() < bucket_count);
+        assert(std::distance(ch.begin(), ch.end()) == 101);
+        for(int i = 0; i < 10000; i += 100)
+        {
+            assert(ch.at(std::to_string(i)) == std::to_string(i * 2));
+        }
+
+        struct keep_config_t : public chash_map_config_t<int, int, std::true_type, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<int const, int>>>
+        {
+            static float compact_proportion(std::size_t)
+            {
+                return 0;
+            }
+        };
+        contiguous_hash<keep_config_t> keep;
+        for(int i = 0; i < 10000; ++i)
+        {
+            keep.emplace(i, i);
+        }
+        for(int i = 0; i < 10000; ++i)
+        {
+            if(i % 100 != 0)
+            {
+                keep.erase(i);
+            }
+        }
+        keep.emplace(-1, -1);
+        assert(keep.size() == 101 && keep.slot_count() == 10000);
+        chash_multiset<int> mset;
+        for(int i = 0; i < 1000; ++i)
+        {
+            mset.insert(i % 10);
+        }
+        for(auto it = mset.begin(); it != mset.end(); )
+        {
+            it = *it % 2 == 0 ? mset.erase(it) : std::next(it);
+        }
+        mset.shrink_to_fit();
+        assert(mset.size() == 500);
+        assert(std::distance(mset.begin(), mset.end()) == 500);
+        auto range = mset.equal_range(3);
+        assert(std::distance(range.first, range.second) == 100);
+        mset.clear();
+        mset.shrink_to_fit();
+        assert(mset.empty());
+        mset.insert(1);
+        assert(mset.count(1) == 1);
+    }();
+    [&]
+    {
+        chash_map<std::string, int> a, b;
+        chash_multiset<std::string> m;
+        auto hash = a.hash_function();
+        for(int i = 0; i < 1000; ++i)
+        {
+            std::string key = std::to_string(i);
+            auto h = hash(key);
+            assert(a.emplace_with_hash(h, key, i).second);
+            assert(!a.emplace_with_hash(h, key, -1).second);
+            if(i % 2 == 0)
+            {
+                b.emplace_with_hash(h, std::make_pair(key, i * 2));
+            }
+            m.emplace_with_hash(h, key);
+            m.emplace_with_hash(h, key);
+        }
+        assert(a.size() == 1000 && b.size() == 500 && m.size() == 2000);
+        for(int i = 0; i < 1000; ++i)
+        {
+            std::string key = std::to_string(i);
+            auto h = hash(key);
+            assert(a.find(key, h) == a.find(key));
+            assert(a.find(key, h)->second == i);
+            assert((b.find(key, h) != b.end()) == (i % 2 == 0));
+            auto range = m.equal_range(key);
+            assert(std::distance(range.first, range.second) == 2);
+        }
+        assert(a.erase("7", hash("7")) == 1);
+        assert(a.erase("7", hash("7")) == 0);
+        assert(m.erase("7", hash("7")) == 2);
+        assert(m.find("7") == m.end());
+        chash_set<int> s;
+        s.emplace_with_hash(s.hash_function()(5), 5);
+        assert(s.find(5, s.hash_function()(5)) != s.end());
+    }();
+    [&]
+    {
+        chash_map<std::string, std::vector<int>> map;
+        auto r = map.try_emplace("a", 3, 7);
+        assert(r.second && r.first->second.size() == 3);
+        r = map.try_emplace("a", 100, 1);
+        assert(!r.second && r.first->second.size() == 3);
+        std::string b = "b";
+        r = map.insert_or_assign(b, std::vector<int>{1});
+        assert(r.second && map.at("b").size() == 1);
+        r = map.insert_or_assign(b, std::vector<int>{1, 2});
+        assert(!r.second && map.at("b").size() == 2 && b == "b");
+        int inserted = 0, updated = 0;
+        for(int i = 0; i < 10000; ++i)
+        {
+            map.upsert(std::to_string(i % 1000), [&]{ ++inserted; return std::vector<int>(1, i); }, [&](std::vector<int> &v){ ++updated; v.push_back(i); });
+        }
+        assert(inserted == 1000 && updated == 9000);
+        assert(map.size() == 1002);
+        assert(map.at("42").size() == 10 && map.at("42")[9] == 9042);
+        chash_map<int, greedy_mapped> greedy;
+        greedy.upsert(1, []{ return greedy_mapped(42); }, [](greedy_mapped &v){ v.value = 0; });
+        assert(greedy.at(1).value == 42);
+        greedy.upsert(1, []{ return greedy_mapped(42); }, [](greedy_mapped &v){ ++v.value; });
+        assert(greedy.at(1).value == 43);
+        chash_map<int, int> counter;
+        for(int i = 0; i < 10000; ++i)
+        {
+            ++counter[i % 777];
+        }
+        assert(counter.size() == 777 && counter[0] == 13 && counter[776] == 12);
+    }();
+    [&]
+    {
+        chash_group_multimap<int, std::string> group;
+        for(int i = 0; i < 1000; ++i)
+        {
+            group.emplace(i % 10, std::to_string(i));
+        }
+        assert(group.size() == 1000 && group.group_count() == 10);
+        auto range = group.equal_range(3);
+        assert(range.size() == 100 && group.count(3) == 100);
+        int n = 3;
+        for(auto &value : range)
+        {
+            assert(value == std::to_string(n));
+            n += 10;
+        }
+        assert(&range[1] == &range[0] + 1);
+        assert(group.equal_range(10).empty());
+        assert(group.erase(3, [](std::string const &value){ return value.size() == 3; }) == 90);
+        assert(group.count(3) == 10 && group.size() == 910);
+        assert(group.erase(4) == 100 && group.group_count() == 9);
+        std::vector<std::string> more{"x", "y"};
+        group.insert(10, more.begin(), more.end());
+        group.insert(std::make_pair(10, std::string("z")));
+        auto const &cgroup = group;
+        assert(cgroup.equal_range(10).size() == 3 && cgroup.equal_range(10)[2] == "z");
+        group.shrink_to_fit();
+        assert(group.size() == 813);
+        group.insert(11, more.end(), more.end());
+        assert(group.group_count() == 10 && group.find(11) == group.end());
+        bool thrown = false;
+        try
+        {
+            group.emplace(11, std::string::npos, 'x');
+        }
+        catch(std::length_error const &)
+        {
+            thrown = true;
+        }
+        assert(thrown && group.group_count() == 10 && group.count(11) == 0 && group.size() == 813);
+        static_assert(std::is_const<std::remove_reference<decltype((group.begin()->second))>::type>::value, "groups are read only");
+        size_t total = 0;
+        for(auto const &value : group)
+        {
+            assert(!value.second.empty());
+            total += value.second.size();
+        }
+        assert(total == group.size());
+    }();
+    [&]
+    {
+        std::vector<int> evicted;
+        chash_lru_cache<int, std::string> lru(3, [&](int const &key, std::string &){ evicted.push_back(key); });
+        lru.try_emplace(1, "1");
+        lru.try_emplace(2, "2");
+        lru.try_emplace(3, "3");
+        assert(*lru.find(1) == "1");
+        lru.try_emplace(4, "4");
+        assert(evicted.size() == 1 && evicted[0] == 2);
+        assert(lru.find(2) == nullptr && lru.size() == 3);
+        assert(!lru.try_emplace(3, "x").second);
+        lru.insert_or_assign(5, std::string("5"));
+        assert(evicted.size() == 2 && evicted[1] == 1);
+        assert(lru.erase(4) && !lru.contains(4) && lru.size() == 2);
+        assert(lru.fetch(6, []{ return std::string("6"); }) == "6");
+        assert(lru.fetch(6, []{ return std::string("x"); }) == "6");
+        chash_lru_cache<int, greedy_mapped> greedy(2);
+        assert(greedy.fetch(1, []{ return greedy_mapped(42); }).value == 42);
+        lru.try_emplace(7, "7");
+        assert(evicted.size() == 3 && evicted[2] == 3);
+        assert(*lru.peek(5) == "5");
+        lru.clear();
+        assert(lru.empty() && lru.capacity() == 3);
+        for(int i = 0; i < 1000; ++i)
+        {
+            lru.try_emplace(i, std::to_string(i));
+        }
+        assert(lru.size() == 3 && lru.contains(999) && lru.contains(997) && !lru.contains(996));
+
+        chash_clock_cache<int, int> clock(100);
+        for(int i = 0; i < 100; ++i)
+        {
+            clock.try_emplace(i, i);
+        }
+        for(int i = 0; i < 50; ++i)
+        {
+            clock.find(i);
+        }
+        for(int i = 100; i < 150; ++i)
+        {
+            clock.try_emplace(i, i);
+        }
+        assert(clock.size() == 100);
+        for(int i = 0; i < 50; ++i)
+        {
+            assert(*clock.find(i) == i);
+        }
+        int visited = 0;
+        clock.for_each([&](int const &key, int &value){ assert(key == value); ++visited; });
+        assert(visited == 100);
+    }();
+    [&]
+    {
+        chash_set<int> a, b;
+        for(int i = 0; i < 10000; ++i)
+        {
+            a.insert(i * 2);
+        }
+        for(int i = 0; i < 3000; ++i)
+        {
+            b.insert(i * 3);
+        }
+        auto check = [](chash_set<int> const &s, std::function<bool(int)> pred, int limit)
+        {
+            size_t count = 0;
+            for(int i = 0; i < limit; ++i)
+            {
+                bool expect = pred(i);
+                assert((s.find(i) != s.end()) == expect);
+                count += expect;
+            }
+            assert(s.size() == count);
+        };
+        auto in_a = [](int i){ return i % 2 == 0 && i < 20000; };
+        auto in_b = [](int i){ return i % 3 == 0 && i < 9000; };
+        check(set_intersect(a, b), [&](int i){ return in_a(i) && in_b(i); }, 20000);
+        check(set_intersect(b, a), [&](int i){ return in_a(i) && in_b(i); }, 20000);
+        check(set_union(a, b), [&](int i){ return in_a(i) || in_b(i); }, 20000);
+        check(set_difference(a, b), [&](int i){ return in_a(i) && !in_b(i); }, 20000);
+        check(set_difference(b, a), [&](int i){ return in_b(i) && !in_a(i); }, 20000);
+        check(set_difference(a, chash_set<int>()), in_a, 20000);
+        check(set_intersect(a, chash_set<int>()), [](int){ return false; }, 20000);
+        chash_set<int> c = a;
+        c.set_intersect(b);
+        check(c, [&](int i){ return in_a(i) && in_b(i); }, 20000);
+        c = b;
+        c.set_intersect(a);
+        check(c, [&](int i){ return in_a(i) && in_b(i); }, 20000);
+        c = a;
+        c.set_union(b);
+        check(c, [&](int i){ return in_a(i) || in_b(i); }, 20000);
+        c = a;
+        c.set_difference(b);
+        check(c, [&](int i){ return in_a(i) && !in_b(i); }, 20000);
+        c = b;
+        c.set_difference(a);
+        check(c, [&](int i){ return in_b(i) && !in_a(i); }, 20000);
+        c.set_difference(c);
+        assert(c.empty());
+        chash_map<int, int> m1{{1, 1}, {2, 2}}, m2{{2, 20}, {3, 30}};
+        auto m = set_intersect(m2, m1);
+        assert(m.size() == 1 && m.at(2) == 20);
+        m = set_union(m1, m2);
+        assert(m.size() == 3 && m.at(2) == 2 && m.at(3) == 30);
+    }();
+    [&]
+    {
+        blocked_bloom_filter<int> filter(10000);
+        for(int i = 0; i < 10000; ++i)
+        {
+            filter.insert(i * 7);
+        }
+        size_t false_positive = 0;
+        for(int i = 0; i < 70000; ++i)
+        {
+            if(i % 7 == 0)
+            {
+                assert(filter.may_contain(i));
+            }
+            else
+            {
+                false_positive += filter.may_contain(i);
+            }
+        }
+        assert(false_positive < 60000 / 30);
+        assert(filter.may_contain_hash(filter.hash_function()(7)));
+
+        chash_bloom_set<std::string> set;
+        for(int i = 0; i < 10000; ++i)
+        {
+            set.insert(std::to_string(i));
+        }
+        for(int i = 0; i < 20000; ++i)
+        {
+            assert((set.find(std::to_string(i)) != set.end()) == (i < 10000));
+        }
+        for(int i = 0; i < 10000; i += 2)
+        {
+            set.erase(std::to_string(i));
+        }
+        set.shrink_to_fit();
+        chash_bloom_set<std::string> copy = set;
+        for(int i = 0; i < 10000; ++i)
+        {
+            assert((set.find(std::to_string(i)) != set.end()) == (i % 2 == 1));
+            assert(copy.count(std::to_string(i)) == size_t(i % 2));
+        }
+        copy.clear();
+        assert(copy.find("1") == copy.end());
+        copy.emplace("1");
+        assert(copy.find("1") != copy.end());
+        std::vector<int> data;
+        for(int i = 0; i < 10000; ++i)
+        {
+            data.push_back(i % 5000);
+        }
+        chash_bloom_multiset<int> mset;
+        mset.build(data.begin(), data.end(), 2);
+        auto range = mset.equal_range(42);
+        assert(std::distance(range.first, range.second) == 2);
+        assert(mset.find(5000) == mset.end());
+        chash_bloom_map<int, int> map;
+        map[1] = 2;
+        map.try_emplace(3, 4);
+        assert(map.at(1) == 2 && map.at(3) == 4 && map.find(5) == map.end());
+    }();
+    [&]
+    {
+        struct fifo_config_t : public chash_ordered_config_t<chash_map_config_t<int, int, std::true_type, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<int const, int>>>>
+        {
+            static float compact_proportion(std::size_t)
+            {
+                return 0;
+            }
+        };
+        chash_ordered_map<int, int> fifo;
+        contiguous_hash<fifo_config_t> fifo_keep;
+        for(int i = 0; i < 200000; ++i)
+        {
+            fifo.emplace(i, i);
+            fifo_keep.emplace(i, i);
+            if(i >= 100)
+            {
+                fifo.erase(i - 100);
+                fifo_keep.erase(i - 100);
+            }
+        }
+        assert(fifo.size() == 100 && fifo.slot_count() < 1000 && fifo.begin()->first == 199900);
+        assert(fifo_keep.size() == 100 && fifo_keep.slot_count() < 1000 && fifo_keep.bucket_count() < 1000);
+        assert(std::distance(fifo_keep.begin(), fifo_keep.end()) == 100 && fifo_keep.begin()->first == 199900);
+
+        chash_ordered_map<int, int> map;
+        std::vector<int> order;
+        std::mt19937 mt(1);
+        for(int i = 0; i < 5000; ++i)
+        {
+            int key = int(mt() % 100000);
+            if(map.emplace(key, i).second)
+            {
+                order.push_back(key);
+            }
+            if(i % 3 == 0 && !order.empty())
+            {
+                int erase_key = order[mt() % order.size()];
+                map.erase(erase_key);
+                order.erase(std::find(order.begin(), order.end(), erase_key));
+            }
+        }
+        assert(map.size() == order.size());
+        size_t n = 0;
+        for(auto &value : map)
+        {
+            assert(value.first == order[n++]);
+        }
+        map.shrink_to_fit();
+        n = 0;
+        for(auto &value : map)
+        {
+            assert(value.first == order[n++]);
+        }
+        std::vector<uint32_t> index;
+        for(int key : order)
+        {
+            index.push_back(uint32_t(map.slot_id(map.find(key))));
+        }
+        for(size_t i = 0; i < order.size(); ++i)
+        {
+            assert(map.at_slot(index[i]).first == order[i]);
+            assert(map.iterator_at_slot(index[i]) == map.find(order[i]));
+        }
+        assert(map.slot_count() == map.size());
+        map.erase(order[0]);
+        assert(!map.slot_valid(index[0]) && map.iterator_at_slot(index[0]) == map.end());
+        bool thrown = false;
+        try
+        {
+            map.at_slot(index[0]);
+        }
+        catch(std::out_of_range const &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        map.emplace(-1, -1);
+        assert(map.slot_id(map.find(-1)) == map.slot_count() - 1);
+        assert(map.at_slot(index[1]).first == order[1]);
+
+        chash_set<int> set;
+        for(int i = 0; i < 100; ++i)
+        {
+            set.insert(i);
+        }
+        set.erase(5);
+        set.insert(1000);
+        assert(set.slot_id(set.find(1000)) == 5 && set.at_slot(5) == 1000);
+    }();
+    [&]
+    {
+        huge_page_allocator<int> alloc;
+        size_t count = huge_page_allocator<int>::huge_page_size / sizeof(int) * 2;
+        int *block = alloc.allocate(count);
+        for(size_t i = 0; i < count; ++i)
+        {
+            block[i] = int(i);
+        }
+        int *grown = alloc.reallocate(block, count, count * 3);
+        if(grown != nullptr)
+        {
+            block = grown;
+            for(size_t i = 0; i < count; ++i)
+            {
+                assert(block[i] == int(i));
+            }
+            count *= 3;
+        }
+        alloc.deallocate(block, count);
+        alloc.deallocate(alloc.allocate(10), 10);
+
+        chash_map<int, int, std::hash<int>, std::equal_to<int>, huge_page_allocator<std::pair<int const, int>>> map;
+        for(int i = 0; i < 1000000; ++i)
+        {
+            map.emplace(i, i * 2);
+        }
+        for(int i = 0; i < 1000000; i += 7)
+        {
+            assert(map.at(i) == i * 2);
+        }
+        for(int i = 0; i < 1000000; i += 2)
+        {
+            map.erase(i);
+        }
+        map.shrink_to_fit();
+        assert(map.size() == 500000 && map.at(999) == 1998);
+        chash_set<std::string, std::hash<std::string>, std::equal_to<std::string>, huge_page_allocator<std::string>> set;
+        for(int i = 0; i < 200000; ++i)
+        {
+            set.emplace(std::to_string(i));
+        }
+        assert(set.size() == 200000 && set.find("199999") != set.end());
+    }();
+    [&]
+    {
+        struct bad_hash
+        {
+            size_t operator()(int value) const
+            {
+                return size_t(value % 10);
+            }
+        };
+        chash_set<int> good;
+        chash_set<int, bad_hash> bad;
+        for(int i = 0; i < 1000; ++i)
+        {
+            good.insert(i);
+            bad.insert(i);
+        }
+        auto g = good.probe_stats();
+        auto b = bad.probe_stats();
+        assert(g.size == 1000 && g.slot_count == 1000 && g.free_count == 0 && g.capacity >= 1000);
+        assert(g.bucket_count == good.bucket_count() && g.load_factor == good.load_factor());
+        size_t total = 0, buckets = 0;
+        for(size_t i = 0; i < b.chain_histogram.size(); ++i)
+        {
+            total += i * b.chain_histogram[i];
+            buckets += b.chain_histogram[i];
+        }
+        assert(total == 1000 && buckets == bad.bucket_count());
+        assert(b.chain_histogram.size() == 101 && b.chain_histogram[100] == 10);
+        assert(g.success_compare == 1 && g.fail_compare == 1 && g.success_probe < 2);
+        assert(b.success_probe == 50.5 && b.success_compare == 50.5 && b.fail_compare == 100);
+        assert(b.fail_probe == double(1000) / bad.bucket_count());
+        bad.erase(3);
+        assert(bad.probe_stats().free_count == 1);
+        assert(chash_set<int>().probe_stats().size == 0);
+
+        struct status_config_t : public chash_set_config_t<int, std::true_type, bad_hash, std::equal_to<int>, std::allocator<int>>
+        {
+            typedef std::true_type status_type;
+        };
+        contiguous_hash<status_config_t> counted;
+        for(int i = 0; i < 100; ++i)
+        {
+            counted.insert(i);
+        }
+        auto lookup = counted.status().lookup_count;
+        auto probe = counted.status().probe_count;
+        auto compare = counted.status().compare_count;
+        assert(lookup == 100);
+        //95 is the newest of its chain, 1000 shares the full hash of a chain of 10
+        assert(counted.find(95) != counted.end());
+        assert(counted.find(1000) == counted.end());
+        assert(counted.status().lookup_count == lookup + 2 && counted.status().hit_count == 1);
+        assert(counted.status().probe_count == probe + 1 + 10);
+        assert(counted.status().compare_count == compare + 1 + 10);
+        auto const &reader = counted;
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&reader]
+            {
+                for(int i = 0; i < 1000; ++i)
+                {
+                    reader.find(i % 200);
+                }
+            });
+        }
+        for(auto &thread : threads)
+        {
+            thread.join();
+        }
+        assert(counted.status().lookup_count == lookup + 2 + 4000 && counted.status().hit_count == 1 + 2000);
+    }();
+    [&]
+    {
+        chash_map<std::string, std::vector<int>> a, b;
+        for(int i = 0; i < 100; ++i)
+        {
+            a.emplace(std::to_string(i), std::vector<int>(1000, i));
+        }
+        int const *data = a.at("42").data();
+        auto node = a.extract("42");
+        assert(!node.empty() && node.key() == "42" && node.mapped().data() == data);
+        assert(node.hash() == (a.hash_function()("42") & (~std::size_t(0) >> 1)));
+        assert(a.find("42") == a.end() && a.size() == 99);
+        assert(a.extract("nothing").empty());
+        auto result = b.insert(std::move(node));
+        assert(result.inserted && result.node.empty() && node.empty());
+        assert(result.position->second.data() == data && b.at("42").size() == 1000);
+        b.emplace("7", std::vector<int>(1, -1));
+        auto dup = b.insert(a.extract(a.find("7")));
+        assert(!dup.inserted && !dup.node.empty() && dup.node.mapped().size() == 1000 && b.at("7").size() == 1);
+        assert(b.insert(decltype(b)::node_type()).position == b.end());
+        a.insert(std::move(dup.node));
+        assert(a.size() == 99 && a.at("7").size() == 1000);
+        b.emplace("1", std::vector<int>());
+        b.merge(a);
+        assert(b.size() == 100 && a.size() == 2 && a.at("1").size() == 1000 && b.at("1").empty() && b.at("7").size() == 1);
+        for(int i = 0; i < 100; ++i)
+        {
+            assert(b.find(std::to_string(i)) != b.end());
+        }
+
+        chash_multiset<int> m1, m2;
+        for(int i = 0; i < 100; ++i)
+        {
+            m1.insert(i % 10);
+            m2.insert(i % 20);
+        }
+        m1.merge(std::move(m2));
+        assert(m1.size() == 200 && m2.empty());
+        auto range = m1.equal_range(5);
+        assert(std::distance(range.first, range.second) == 15);
+        auto mnode = m1.extract(5);
+        assert(mnode.value() == 5);
+        auto it = m1.insert(std::move(mnode));
+        assert(*it == 5 && mnode.empty());
+        range = m1.equal_range(5);
+        assert(std::distance(range.first, range.second) == 15);
+
+        chash_map<int, int> full, same;
+        for(int i = 0; full.size() < 10 || full.size() + 1 <= full.bucket_count() * full.max_load_factor(); ++i)
+        {
+            full.emplace(i, i);
+            same.emplace(i, -i);
+        }
+        size_t bucket_count = full.bucket_count();
+        int const *value = &full.at(0);
+        auto lost = full.insert(same.extract(3));
+        assert(!lost.inserted && !lost.node.empty() && lost.node.mapped() == -3);
+        assert(!full.emplace(1, 0).second && !full.emplace_with_hash(full.hash_function()(2), 2, 0).second);
+        full.merge(same);
+        assert(same.size() == full.size() - 1 && full.at(3) == 3);
+        assert(full.bucket_count() == bucket_count && &full.at(0) == value);
+        full.emplace(-1, -1);
+        assert(full.bucket_count() > bucket_count && full.at(-1) == -1);
+    }();
+    [&]
+    {
+        for(std::size_t threads = 1; threads <= 4; threads += 3)
+        {
+            for(int compact = 0; compact < 2; ++compact)
+            {
+                chash_map<int, std::string> m;
+                chash_multiset<int> ms;
+                for(int i = 0; i < 20000; ++i)
+                {
+                    m.emplace(i, std::to_string(i));
+                    ms.emplace(i % 1000);
+                }
+                m.erase(7);
+                assert(m.erase_if([](std::pair<int const, std::string> &v){ return v.first % 3 == 0; }, compact != 0, threads) == 6667);
+                assert(m.size() == 13332);
+                for(int i = 0; i < 20000; ++i)
+                {
+                    assert((m.find(i) != m.end()) == (i % 3 != 0 && i != 7));
+                }
+                int last = -1, count = 0;
+                for(auto &v : m)
+                {
+                    assert(v.second == std::to_string(v.first) && (compact == 0 || v.first > last));
+                    last = v.first;
+                    ++count;
+                }
+                assert(count == 13332);
+                assert(m.slot_count() == (compact == 0 ? 20000 : 13332));
+                m.emplace(3, "3");
+                assert(m.size() == 13333 && m.at(3) == "3" && m.slot_count() == (compact == 0 ? 20000 : 13333));
+                try
+                {
+                    m.erase_if([](std::pair<int const, std::string> &v){ if(v.first == 10001) throw std::runtime_error("stop"); return v.first % 2 == 0; }, compact != 0, threads);
+                    assert(false);
+                }
+                catch(std::runtime_error const &)
+                {
+                }
+                assert(m.size() == std::size_t(std::distance(m.begin(), m.end())) && m.at(10001) == "10001" && m.at(19999) == "19999");
+                for(auto &v : m)
+                {
+                    assert(m.find(v.first) != m.end() && m.find(v.first)->second == v.second);
+                }
+
+                assert(ms.erase_if([](int v){ return v % 2 == 0; }, compact != 0, threads) == 10000);
+                for(int i = 0; i < 1000; ++i)
+                {
+                    auto range = ms.equal_range(i);
+                    assert(std::distance(range.first, range.second) == (i % 2 == 0 ? 0 : 20));
+                }
+                try
+                {
+                    ms.erase_if([](int v){ if(v == 501) throw std::runtime_error("stop"); return v > 900; }, compact != 0, threads);
+                    assert(false);
+                }
+                catch(std::runtime_error const &)
+                {
+                }
+                assert(ms.size() == std::size_t(std::count_if(ms.begin(), ms.end(), [](int){ return true; })));
+                assert(ms.count(501) == 1 && ms.count(1) == 1);
+            }
+        }
+    }();
     std::unordered_map<int, int> xh;
     chash_map<int, int> ch;
 
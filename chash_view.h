@@ -0,0 +1,376 @@
+#pragma once
+
+#include "chash_map.h"
+#include "chash_set.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+//read only view of a contiguous_hash image written by contiguous_hash::save
+//lookups read the mapped file directly, nothing is loaded or rebuilt
+template<class config_t>
+class contiguous_hash_view
+{
+public:
+    typedef contiguous_hash<config_t> table_type;
+    typedef typename table_type::key_type key_type;
+    typedef typename table_type::mapped_type mapped_type;
+    typedef typename table_type::value_type value_type;
+    typedef typename table_type::size_type size_type;
+    typedef typename table_type::difference_type difference_type;
+    typedef typename table_type::hasher hasher;
+    typedef typename table_type::key_equal key_equal;
+    typedef typename table_type::offset_type offset_type;
+    typedef typename table_type::hash_value_type hash_value_type;
+    typedef value_type const &const_reference;
+    typedef value_type const *const_pointer;
+
+    static constexpr offset_type offset_empty = table_type::offset_empty;
+
+protected:
+    typedef typename table_type::hash_t hash_t;
+    typedef typename table_type::index_t index_t;
+    typedef typename table_type::value_t value_t;
+    typedef typename table_type::get_key_t get_key_t;
+    typedef contiguous_hash_detail::image_header_t header_t;
+
+    struct root_t : public hasher, public key_equal
+    {
+        root_t(hasher const &hash, key_equal const &equal) : hasher(hash), key_equal(equal)
+        {
+            bucket_count = 0;
+            size = 0;
+            free_count = 0;
+            bucket = nullptr;
+            index = nullptr;
+            value = nullptr;
+            map_address = nullptr;
+            map_size = 0;
+        }
+        size_type bucket_count;
+        size_type size;
+        size_type free_count;
+        offset_type const *bucket;
+        index_t const *index;
+        value_t const *value;
+        void *map_address;
+        size_type map_size;
+    };
+
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename contiguous_hash_view::value_type value_type;
+        typedef typename contiguous_hash_view::difference_type difference_type;
+        typedef typename contiguous_hash_view::const_reference reference;
+        typedef typename contiguous_hash_view::const_pointer pointer;
+    public:
+        const_iterator(size_type _offset, contiguous_hash_view const *_self) : offset(_offset), self(_self)
+        {
+        }
+        const_iterator(const_iterator const &) = default;
+        const_iterator &operator++()
+        {
+            offset = self->advance_next_(offset);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator save(*this);
+            ++*this;
+            return save;
+        }
+        reference operator *() const
+        {
+            return *self->root_.value[offset].value();
+        }
+        pointer operator->() const
+        {
+            return self->root_.value[offset].value();
+        }
+        bool operator == (const_iterator const &other) const
+        {
+            return offset == other.offset && self == other.self;
+        }
+        bool operator != (const_iterator const &other) const
+        {
+            return offset != other.offset || self != other.self;
+        }
+    private:
+        friend class contiguous_hash_view;
+        size_type offset;
+        contiguous_hash_view const *self;
+    };
+    typedef const_iterator iterator;
+
+public:
+    //empty
+    contiguous_hash_view() : root_(hasher(), key_equal())
+    {
+    }
+    //move
+    contiguous_hash_view(contiguous_hash_view &&other) : root_(other.get_hasher(), other.get_key_equal())
+    {
+        std::swap(root_, other.root_);
+    }
+    //destructor
+    ~contiguous_hash_view()
+    {
+        unmap_();
+    }
+    //move
+    contiguous_hash_view &operator = (contiguous_hash_view &&other)
+    {
+        if(this != &other)
+        {
+            unmap_();
+            root_ = root_t(other.get_hasher(), other.get_key_equal());
+            std::swap(root_, other.root_);
+        }
+        return *this;
+    }
+    contiguous_hash_view(contiguous_hash_view const &) = delete;
+    contiguous_hash_view &operator = (contiguous_hash_view const &) = delete;
+
+    //hasher and key_equal must behave the same as the ones used by save
+    static contiguous_hash_view open(char const *path, hasher const &hash = hasher(), key_equal const &equal = key_equal())
+    {
+        static_assert(contiguous_hash_detail::is_trivial_expand<value_type>::value, "contiguous_hash_view requires trivial value_type");
+        contiguous_hash_view view;
+        view.root_ = root_t(hash, equal);
+        view.map_(path);
+        return view;
+    }
+
+    hasher hash_function() const
+    {
+        return get_hasher();
+    }
+    key_equal key_eq() const
+    {
+        return get_key_equal();
+    }
+
+    template<class in_key_t> const_iterator find(in_key_t const &key) const
+    {
+        if(root_.size == 0)
+        {
+            return end();
+        }
+        return const_iterator(find_value_(key), this);
+    }
+    template<class in_key_t> size_type count(in_key_t const &key) const
+    {
+        if(root_.size == 0)
+        {
+            return 0;
+        }
+        hash_t hash = get_hasher()(key);
+        size_type count = 0, step = 0;
+        for(size_type i = root_.bucket[hash % root_.bucket_count]; i != offset_empty; i = root_.index[i].next)
+        {
+            check_link_(i, step);
+            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), key))
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(advance_next_(size_type(-1)), this);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(root_.size, this);
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    bool empty() const
+    {
+        return root_.size == root_.free_count;
+    }
+    size_type size() const
+    {
+        return root_.size - root_.free_count;
+    }
+    size_type bucket_count() const
+    {
+        return root_.bucket_count;
+    }
+
+protected:
+    root_t root_;
+
+protected:
+    hasher const &get_hasher() const
+    {
+        return root_;
+    }
+    key_equal const &get_key_equal() const
+    {
+        return root_;
+    }
+
+    size_type advance_next_(size_type i) const
+    {
+        for(++i; i < root_.size; ++i)
+        {
+            if(root_.index[i].hash)
+            {
+                break;
+            }
+        }
+        return i;
+    }
+
+    //bucket heads and next links come from the untrusted image, a link past size or a chain longer than size (a loop) is a bad image
+    void check_link_(size_type i, size_type &step) const
+    {
+        if(i >= root_.size || ++step > root_.size)
+        {
+            throw std::runtime_error("contiguous_hash_view bad image");
+        }
+    }
+
+    template<class in_key_t> size_type find_value_(in_key_t const &key) const
+    {
+        hash_t hash = get_hasher()(key);
+        size_type step = 0;
+        for(size_type i = root_.bucket[hash % root_.bucket_count]; i != offset_empty; i = root_.index[i].next)
+        {
+            check_link_(i, step);
+            if(root_.index[i].hash == hash && get_key_equal()(get_key_t()(*root_.value[i].value()), key))
+            {
+                return i;
+            }
+        }
+        return root_.size;
+    }
+
+    //count elements at position end inside file_size, written without overflow since the header is untrusted
+    static bool region_valid_(std::uint64_t position, std::uint64_t count, std::uint64_t element_size, std::uint64_t align, std::uint64_t file_size)
+    {
+        return position <= file_size && position % align == 0 && count <= (file_size - position) / element_size && count <= std::uint64_t(size_type(-1));
+    }
+
+    void map_(char const *path)
+    {
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        LARGE_INTEGER file_size;
+        if(!GetFileSizeEx(file, &file_size))
+        {
+            CloseHandle(file);
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        HANDLE mapping = file_size.QuadPart == 0 ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if(mapping == nullptr)
+        {
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        void *address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if(address == nullptr)
+        {
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        root_.map_address = address;
+        root_.map_size = size_type(file_size.QuadPart);
+#else
+        int file = ::open(path, O_RDONLY);
+        if(file == -1)
+        {
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        struct stat file_stat;
+        if(::fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+        {
+            ::close(file);
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        void *address = ::mmap(nullptr, size_type(file_stat.st_size), PROT_READ, MAP_SHARED, file, 0);
+        ::close(file);
+        if(address == MAP_FAILED)
+        {
+            throw std::runtime_error("contiguous_hash_view open failed");
+        }
+        root_.map_address = address;
+        root_.map_size = size_type(file_stat.st_size);
+#endif
+        char const *base = static_cast<char const *>(root_.map_address);
+        header_t const *header = reinterpret_cast<header_t const *>(base);
+        if(root_.map_size < sizeof(header_t)
+            || std::memcmp(header->magic, contiguous_hash_detail::image_magic, sizeof header->magic) != 0
+            || header->offset_size != sizeof(offset_type)
+            || header->index_size != sizeof(index_t)
+            || header->value_size != sizeof(value_t)
+            || header->value_align != std::alignment_of<value_t>::value
+            || header->file_size > root_.map_size
+            || header->size < header->free_count
+            || (header->size != 0 && header->bucket_count == 0)
+            || !region_valid_(header->bucket_position, header->bucket_count, sizeof(offset_type), std::alignment_of<offset_type>::value, header->file_size)
+            || !region_valid_(header->index_position, header->size, sizeof(index_t), std::alignment_of<index_t>::value, header->file_size)
+            || !region_valid_(header->value_position, header->size, sizeof(value_t), std::alignment_of<value_t>::value, header->file_size))
+        {
+            unmap_();
+            throw std::runtime_error("contiguous_hash_view bad image");
+        }
+        root_.bucket_count = size_type(header->bucket_count);
+        root_.size = size_type(header->size);
+        root_.free_count = size_type(header->free_count);
+        root_.bucket = reinterpret_cast<offset_type const *>(base + header->bucket_position);
+        root_.index = reinterpret_cast<index_t const *>(base + header->index_position);
+        root_.value = reinterpret_cast<value_t const *>(base + header->value_position);
+    }
+
+    void unmap_()
+    {
+        if(root_.map_address != nullptr)
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(root_.map_address);
+#else
+            ::munmap(root_.map_address, root_.map_size);
+#endif
+        }
+        root_.bucket_count = 0;
+        root_.size = 0;
+        root_.free_count = 0;
+        root_.map_address = nullptr;
+        root_.map_size = 0;
+    }
+};
+template<class config_t> constexpr typename contiguous_hash_view<config_t>::offset_type contiguous_hash_view<config_t>::offset_empty;
+
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_map_view = contiguous_hash_view<chash_map_config_t<key_t, value_t, std::true_type, hasher_t, key_equal_t, allocator_t>>;
+template<class key_t, class value_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using chash_multimap_view = contiguous_hash_view<chash_map_config_t<key_t, value_t, std::false_type, hasher_t, key_equal_t, allocator_t>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_set_view = contiguous_hash_view<chash_set_config_t<key_t, std::true_type, hasher_t, key_equal_t, allocator_t>>;
+template<class key_t, class hasher_t = std::hash<key_t>, class key_equal_t = std::equal_to<key_t>, class allocator_t = std::allocator<key_t>>
+using chash_multiset_view = contiguous_hash_view<chash_set_config_t<key_t, std::false_type, hasher_t, key_equal_t, allocator_t>>;
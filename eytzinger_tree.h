@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <iterator>
+
+
+namespace eytzinger_tree_detail
+{
+    //k with its trailing ones and the zero above them shifted out
+    inline std::size_t climb(std::size_t k)
+    {
+#if defined(__GNUC__)
+        return k >> __builtin_ffsll(static_cast<long long>(~k));
+#else
+        while(k & 1)
+        {
+            k >>= 1;
+        }
+        return k >> 1;
+#endif
+    }
+
+    inline void prefetch(void const *address)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+}
+
+//read only snapshot of a sorted container, keys kept in eytzinger (bfs) order, values kept sorted
+//the search touches one cache line per level and prefetches the block 4 levels down, no branch on the compare
+//find/lower_bound/upper_bound/rank are O(log n), at/iteration are O(1) over a contiguous array
+//built from size_balanced_tree or b_plus_plus_tree (same config_t), or from any sorted range
+template<class config_t>
+class eytzinger_tree
+{
+public:
+    typedef typename config_t::key_type key_type;
+    typedef typename config_t::mapped_type mapped_type;
+    typedef typename config_t::value_type value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename config_t::key_compare key_compare;
+    typedef typename config_t::allocator_type allocator_type;
+    typedef value_type const &reference;
+    typedef value_type const &const_reference;
+    typedef value_type const *pointer;
+    typedef value_type const *const_pointer;
+    typedef value_type const *iterator;
+    typedef value_type const *const_iterator;
+    typedef std::reverse_iterator<const_iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+protected:
+    typedef typename std::remove_const<value_type>::type storage_type;
+    typedef std::vector<storage_type, typename allocator_type::template rebind<storage_type>::other> value_array_t;
+    typedef std::vector<key_type, typename allocator_type::template rebind<key_type>::other> key_array_t;
+    typedef std::vector<size_type, typename allocator_type::template rebind<size_type>::other> rank_array_t;
+    //keys of one cache line, the prefetch target is that many slots below k
+    static size_type const prefetch_stride = sizeof(key_type) >= 64 ? 1 : 64 / sizeof(key_type);
+
+public:
+    //empty
+    eytzinger_tree() : eytzinger_tree(key_compare(), allocator_type())
+    {
+    }
+    //empty
+    explicit eytzinger_tree(key_compare const &comp, allocator_type const &alloc = allocator_type()) : comp_(comp), value_(alloc), key_(1, key_type(), alloc), rank_(1, 0, alloc)
+    {
+    }
+    //range sorted by comp
+    template<class iterator_t, class = typename std::iterator_traits<iterator_t>::iterator_category> eytzinger_tree(iterator_t begin, iterator_t end, key_compare const &comp = key_compare(), allocator_type const &alloc = allocator_type()) : comp_(comp), value_(begin, end, alloc), key_(value_.size() + 1, key_type(), alloc), rank_(value_.size() + 1, 0, alloc)
+    {
+        fill_(0, 1);
+    }
+    //snapshot of a size_balanced_tree or a b_plus_plus_tree, same comparator and allocator
+    template<class tree_t, class = decltype(std::declval<tree_t const &>().key_comp())> explicit eytzinger_tree(tree_t const &tree) : eytzinger_tree(tree.begin(), tree.end(), tree.key_comp(), tree.get_allocator())
+    {
+    }
+
+    key_compare key_comp() const
+    {
+        return comp_;
+    }
+    allocator_type get_allocator() const
+    {
+        return value_.get_allocator();
+    }
+
+    const_iterator begin() const
+    {
+        return value_.data();
+    }
+    const_iterator end() const
+    {
+        return value_.data() + value_.size();
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+    const_reference front() const
+    {
+        return value_.front();
+    }
+    const_reference back() const
+    {
+        return value_.back();
+    }
+    bool empty() const
+    {
+        return value_.empty();
+    }
+    size_type size() const
+    {
+        return value_.size();
+    }
+
+    //if(index >= size) return end
+    const_iterator at(size_type index) const
+    {
+        return begin() + std::min(index, size());
+    }
+    const_reference operator[](size_type index) const
+    {
+        return value_[index];
+    }
+
+    const_iterator lower_bound(key_type const &key) const
+    {
+        return begin() + search_<false>(key);
+    }
+    const_iterator upper_bound(key_type const &key) const
+    {
+        return begin() + search_<true>(key);
+    }
+    std::pair<const_iterator, const_iterator> equal_range(key_type const &key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    const_iterator find(key_type const &key) const
+    {
+        size_type index = search_<false>(key);
+        return (index == size() || comp_(key, config_t::get_key(value_[index]))) ? end() : begin() + index;
+    }
+    size_type count(key_type const &key) const
+    {
+        return search_<true>(key) - search_<false>(key);
+    }
+
+    //rank(begin) == 0, key rank
+    size_type rank(key_type const &key) const
+    {
+        return search_<false>(key);
+    }
+    //rank(begin) == 0, rank of iterator
+    size_type rank(const_iterator where) const
+    {
+        return size_type(where - begin());
+    }
+    //rank(begin) == 0, key rank current best
+    size_type lower_rank(key_type const &key) const
+    {
+        return search_<false>(key);
+    }
+    //rank(begin) == 0, key rank when insert
+    size_type upper_rank(key_type const &key) const
+    {
+        return search_<true>(key);
+    }
+
+protected:
+    key_compare comp_;
+    value_array_t value_;
+    //1 based, children of k are 2k and 2k + 1, slot 0 unused
+    key_array_t key_;
+    //sorted index of every slot
+    rank_array_t rank_;
+
+protected:
+    //in order walk of the implicit tree hands out sorted indexes
+    size_type fill_(size_type index, size_type k)
+    {
+        if(k < key_.size())
+        {
+            index = fill_(index, 2 * k);
+            key_[k] = config_t::get_key(value_[index]);
+            rank_[k] = index;
+            index = fill_(index + 1, 2 * k + 1);
+        }
+        return index;
+    }
+
+    //the path bits record every turn, the last left turn is the answer
+    template<bool is_upper> size_type search_(key_type const &key) const
+    {
+        key_type const *base = key_.data();
+        size_type count = value_.size(), k = 1;
+        while(k <= count)
+        {
+            eytzinger_tree_detail::prefetch(reinterpret_cast<void const *>(reinterpret_cast<std::uintptr_t>(base) + k * prefetch_stride * sizeof(key_type)));
+            bool is_right = is_upper ? !comp_(key, base[k]) : comp_(base[k], key);
+            k = 2 * k + size_type(is_right);
+        }
+        k = eytzinger_tree_detail::climb(k);
+        return k == 0 ? count : rank_[k];
+    }
+};
+
+//freeze a size_balanced_tree or b_plus_plus_tree
+template<template<class> class tree_t, class config_t> eytzinger_tree<config_t> freeze(tree_t<config_t> const &tree)
+{
+    return eytzinger_tree<config_t>(tree);
+}
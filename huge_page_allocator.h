@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+namespace huge_page_allocator_detail
+{
+    static std::size_t const huge_page_size = 0x200000;
+
+    inline std::size_t round_up(std::size_t bytes)
+    {
+        return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+    }
+
+    //size is a multiple of huge_page_size, nullptr on failure
+    inline void *map(std::size_t size)
+    {
+#if defined(_WIN32)
+        SIZE_T large_page = GetLargePageMinimum();
+        if(large_page != 0 && size % large_page == 0)
+        {
+            void *address = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if(address != nullptr)
+            {
+                return address;
+            }
+        }
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+        void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(address != MAP_FAILED)
+        {
+            return address;
+        }
+#endif
+        //no reserved huge pages, map more and trim to a huge page boundary so transparent huge pages can back it
+        std::size_t map_size = size + huge_page_size;
+        char *base = static_cast<char *>(::mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if(base == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        char *aligned = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(base) + huge_page_size - 1) & ~std::uintptr_t(huge_page_size - 1));
+        if(aligned != base)
+        {
+            ::munmap(base, std::size_t(aligned - base));
+        }
+        std::size_t tail = std::size_t(base + map_size - (aligned + size));
+        if(tail != 0)
+        {
+            ::munmap(aligned + size, tail);
+        }
+#if defined(MADV_HUGEPAGE)
+        ::madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+        return aligned;
+#endif
+    }
+
+    inline void unmap(void *address, std::size_t size)
+    {
+#if defined(_WIN32)
+        (void)size;
+        VirtualFree(address, 0, MEM_RELEASE);
+#else
+        ::munmap(address, size);
+#endif
+    }
+
+    //both sizes are multiples of huge_page_size, nullptr if the mapping can not be resized, address stays valid then
+    inline void *remap(void *address, std::size_t old_size, std::size_t new_size)
+    {
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        void *new_address = ::mremap(address, old_size, new_size, MREMAP_MAYMOVE);
+        if(new_address == MAP_FAILED)
+        {
+            return nullptr;
+        }
+#if defined(MADV_HUGEPAGE)
+        ::madvise(new_address, new_size, MADV_HUGEPAGE);
+#endif
+        return new_address;
+#else
+        (void)address;
+        (void)old_size;
+        (void)new_size;
+        return nullptr;
+#endif
+    }
+}
+
+//blocks of at least 2M bytes are backed by huge pages, smaller blocks use operator new
+//linux tries MAP_HUGETLB, then falls back to a 2M aligned mapping advised for transparent huge pages
+//reallocate grows or shrinks a mapping in place or by moving page tables (mremap), contiguous_hash uses it for trivial types
+template<class T>
+class huge_page_allocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef T const *const_pointer;
+    typedef T &reference;
+    typedef T const &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    template<class U> struct rebind
+    {
+        typedef huge_page_allocator<U> other;
+    };
+
+    static std::size_t const huge_page_size = huge_page_allocator_detail::huge_page_size;
+
+public:
+    huge_page_allocator() noexcept
+    {
+    }
+    template<class U> huge_page_allocator(huge_page_allocator<U> const &) noexcept
+    {
+    }
+
+    pointer allocate(size_type count)
+    {
+        if(count > max_size())
+        {
+            throw std::bad_alloc();
+        }
+        std::size_t bytes = count * sizeof(T);
+        if(bytes < huge_page_size)
+        {
+            return static_cast<pointer>(::operator new(bytes));
+        }
+        void *address = huge_page_allocator_detail::map(huge_page_allocator_detail::round_up(bytes));
+        if(address == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<pointer>(address);
+    }
+    void deallocate(pointer address, size_type count) noexcept
+    {
+        std::size_t bytes = count * sizeof(T);
+        if(bytes < huge_page_size)
+        {
+            ::operator delete(address);
+        }
+        else
+        {
+            huge_page_allocator_detail::unmap(address, huge_page_allocator_detail::round_up(bytes));
+        }
+    }
+    //bytes are kept as is up to the smaller count, nullptr if the block can not be resized, address stays valid then
+    pointer reallocate(pointer address, size_type old_count, size_type new_count) noexcept
+    {
+        std::size_t old_bytes = old_count * sizeof(T), new_bytes = new_count * sizeof(T);
+        if(new_count > max_size() || old_bytes < huge_page_size || new_bytes < huge_page_size)
+        {
+            return nullptr;
+        }
+        std::size_t old_size = huge_page_allocator_detail::round_up(old_bytes), new_size = huge_page_allocator_detail::round_up(new_bytes);
+        if(old_size == new_size)
+        {
+            return address;
+        }
+        return static_cast<pointer>(huge_page_allocator_detail::remap(address, old_size, new_size));
+    }
+    size_type max_size() const noexcept
+    {
+        return (std::numeric_limits<size_type>::max() - huge_page_size) / sizeof(T);
+    }
+
+    template<class U> bool operator == (huge_page_allocator<U> const &) const noexcept
+    {
+        return true;
+    }
+    template<class U> bool operator != (huge_page_allocator<U> const &) const noexcept
+    {
+        return false;
+    }
+};
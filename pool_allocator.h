@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <utility>
+
+
+namespace pool_allocator_detail
+{
+    //fixed size blocks carved from chunks, freed blocks go to a lifo list and chunks live until the pool dies
+    class pool_t
+    {
+    public:
+        pool_t(std::size_t block_size, std::size_t chunk_count) : block_size_(block_size), chunk_count_(std::max<std::size_t>(chunk_count, 1)), next_count_(std::min<std::size_t>(chunk_count_, 16)), free_(nullptr), bump_(nullptr), bump_end_(nullptr)
+        {
+        }
+        pool_t(pool_t const &) = delete;
+        pool_t &operator = (pool_t const &) = delete;
+        ~pool_t()
+        {
+            for(void *chunk : chunk_)
+            {
+                ::operator delete(chunk);
+            }
+        }
+
+        void *allocate()
+        {
+            if(free_ != nullptr)
+            {
+                void *block = free_;
+                free_ = *static_cast<void **>(free_);
+                return block;
+            }
+            if(bump_ == bump_end_)
+            {
+                grow_();
+            }
+            void *block = bump_;
+            bump_ += block_size_;
+            return block;
+        }
+        void deallocate(void *block) noexcept
+        {
+            *static_cast<void **>(block) = free_;
+            free_ = block;
+        }
+
+        std::size_t block_size() const
+        {
+            return block_size_;
+        }
+        static std::size_t round_up_(std::size_t size, std::size_t align)
+        {
+            return (size + align - 1) / align * align;
+        }
+
+    private:
+        //chunks grow from 16 blocks up to chunk_count, small pools stay small
+        void grow_()
+        {
+            chunk_.reserve(chunk_.size() + 1);
+            char *chunk = static_cast<char *>(::operator new(block_size_ * next_count_));
+            chunk_.push_back(chunk);
+            bump_ = chunk;
+            bump_end_ = chunk + block_size_ * next_count_;
+            next_count_ = std::min(next_count_ * 2, chunk_count_);
+        }
+
+        std::size_t block_size_;
+        std::size_t chunk_count_;
+        std::size_t next_count_;
+        void *free_;
+        char *bump_;
+        char *bump_end_;
+        std::vector<void *> chunk_;
+    };
+
+    //one pool per block size, shared by an allocator, its copies and its rebound copies
+    class pool_set_t
+    {
+    public:
+        explicit pool_set_t(std::size_t chunk_count) : chunk_count_(chunk_count)
+        {
+        }
+        pool_t *get(std::size_t size, std::size_t align)
+        {
+            std::size_t block_size = pool_t::round_up_(std::max(size, sizeof(void *)), std::max(align, alignof(void *)));
+            for(auto &pool : pool_)
+            {
+                if(pool->block_size() == block_size)
+                {
+                    return pool.get();
+                }
+            }
+            pool_.emplace_back(new pool_t(block_size, chunk_count_));
+            return pool_.back().get();
+        }
+
+    private:
+        std::size_t chunk_count_;
+        std::vector<std::unique_ptr<pool_t>> pool_;
+    };
+}
+
+//single object allocations come from a pool of fixed size chunks, arrays use operator new
+//node containers (sbtree, bpptree, segment_array) then do one malloc per chunk instead of per node and keep nodes close together
+//copies and rebound copies share one set of pools (one pool per block size) and compare equal, nothing is locked
+//a copy constructed container selects pools of its own, copy assignment keeps the pools of the target
+//containers built from one allocator explicitly share its pools and must stay in one thread
+//only the allocation is pooled, the node layout (pointers and size) is the container's and does not shrink
+template<class T, std::size_t chunk_count = 1024>
+class pool_allocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef T const *const_pointer;
+    typedef T &reference;
+    typedef T const &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    template<class U> struct rebind
+    {
+        typedef pool_allocator<U, chunk_count> other;
+    };
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over aligned type");
+
+public:
+    pool_allocator() : set_(std::make_shared<pool_allocator_detail::pool_set_t>(chunk_count)), pool_(set_->get(sizeof(T), alignof(T)))
+    {
+    }
+    pool_allocator(pool_allocator const &) = default;
+    template<class U> pool_allocator(pool_allocator<U, chunk_count> const &other) : set_(other.set_), pool_(set_->get(sizeof(T), alignof(T)))
+    {
+    }
+    pool_allocator &operator = (pool_allocator const &) = default;
+    pool_allocator select_on_container_copy_construction() const
+    {
+        return pool_allocator();
+    }
+
+    pointer allocate(size_type count)
+    {
+        if(count == 1)
+        {
+            return static_cast<pointer>(pool_->allocate());
+        }
+        if(count > max_size())
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<pointer>(::operator new(count * sizeof(T)));
+    }
+    void deallocate(pointer address, size_type count) noexcept
+    {
+        if(count == 1)
+        {
+            pool_->deallocate(address);
+        }
+        else
+        {
+            ::operator delete(address);
+        }
+    }
+    template<class U, class ...args_t> void construct(U *address, args_t &&...args)
+    {
+        ::new(static_cast<void *>(address)) U(std::forward<args_t>(args)...);
+    }
+    template<class U> void destroy(U *address)
+    {
+        address->~U();
+    }
+    size_type max_size() const noexcept
+    {
+        return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    template<class U> bool operator == (pool_allocator<U, chunk_count> const &other) const noexcept
+    {
+        return set_ == other.set_;
+    }
+    template<class U> bool operator != (pool_allocator<U, chunk_count> const &other) const noexcept
+    {
+        return set_ != other.set_;
+    }
+
+private:
+    template<class, std::size_t> friend class pool_allocator;
+    std::shared_ptr<pool_allocator_detail::pool_set_t> set_;
+    pool_allocator_detail::pool_t *pool_;
+};
@@ -6,6 +6,66 @@
 #include <memory>
 #include <stdexcept>
 #include <tuple>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+
+
+namespace size_balanced_tree_detail
+{
+    //config_t without augment_type
+    struct augment_none_t
+    {
+        typedef augment_none_t type;
+    };
+    //config_t::augment_type keeps an aggregate of every subtree in its root, see sbtree_augment.h
+    //  typedef ... type;                               aggregate of a subtree
+    //  static type identity();                         aggregate of no element
+    //  static type lift(value_type const &);           aggregate of one element
+    //  static type combine(type const &, type const &); associative, left part first
+    template<class config_t, class = void> struct augment_select_t : public std::false_type
+    {
+        typedef augment_none_t policy_type;
+        struct holder_t
+        {
+        };
+    };
+    template<class config_t> struct augment_select_t<config_t, typename std::conditional<true, void, typename config_t::augment_type>::type> : public std::true_type
+    {
+        typedef typename config_t::augment_type policy_type;
+        struct holder_t
+        {
+            typename policy_type::type aggregate;
+        };
+    };
+
+    //config_t::unique_type is std::true_type to keep keys unique, insert returns std::pair<iterator, bool> then
+    template<class config_t, class = void> struct unique_select_t : public std::false_type
+    {
+    };
+    template<class config_t> struct unique_select_t<config_t, typename std::enable_if<config_t::unique_type::value>::type> : public std::true_type
+    {
+    };
+
+    //config_t::top_down_type is std::true_type to rebalance on the way down, insert is then one pass with no walk back up
+    //the tree is then weight balanced instead of size balanced, see sbt_insert_top_down_
+    template<class config_t, class = void> struct top_down_select_t : public std::false_type
+    {
+    };
+    template<class config_t> struct top_down_select_t<config_t, typename std::enable_if<config_t::top_down_type::value>::type> : public std::true_type
+    {
+    };
+
+    //the top down descent asks for both grandchildren while it still compares
+    inline void prefetch(void const *address)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+}
 
 template<class config_t>
 class size_balanced_tree
@@ -18,12 +78,18 @@ public:
     typedef std::ptrdiff_t difference_type;
     typedef typename config_t::key_compare key_compare;
     typedef typename config_t::allocator_type allocator_type;
-    typedef value_type &reference;
+    //config_t::augment_type makes iterators read only, an aggregate would go stale behind a write, use update
+    typedef typename std::conditional<size_balanced_tree_detail::augment_select_t<config_t>::value, value_type const, value_type>::type &reference;
     typedef value_type const &const_reference;
-    typedef value_type *pointer;
+    typedef typename std::conditional<size_balanced_tree_detail::augment_select_t<config_t>::value, value_type const, value_type>::type *pointer;
     typedef value_type const *const_pointer;
+    typedef typename size_balanced_tree_detail::augment_select_t<config_t>::policy_type::type aggregate_type;
 
 protected:
+    typedef size_balanced_tree_detail::augment_select_t<config_t> augment_select_t;
+    typedef size_balanced_tree_detail::unique_select_t<config_t> unique_select_t;
+    typedef size_balanced_tree_detail::top_down_select_t<config_t> top_down_select_t;
+    typedef typename augment_select_t::policy_type augment_policy_t;
     struct node_t
     {
         node_t *parent;
@@ -31,7 +97,7 @@ protected:
         node_t *right;
         size_t size;
     };
-    struct value_node_t : public node_t
+    struct value_node_t : public node_t, public augment_select_t::holder_t
     {
         value_node_t(value_type const &v) : value(v)
         {
@@ -294,7 +360,7 @@ public:
         }
         difference_type operator - (reverse_iterator const &other) const
         {
-            return static_cast<difference_type>(size_balanced_tree::sbt_rank_(other.node)) - static_cast<difference_type>(size_balanced_tree::sbt_rank_(node));
+            return size_balanced_tree::sbt_reverse_rank_(other.node) - size_balanced_tree::sbt_reverse_rank_(node);
         }
         reverse_iterator &operator++()
         {
@@ -404,7 +470,7 @@ public:
         }
         difference_type operator - (const_reverse_iterator const &other) const
         {
-            return static_cast<difference_type>(size_balanced_tree::sbt_rank_(other.node)) - static_cast<difference_type>(size_balanced_tree::sbt_rank_(node));
+            return size_balanced_tree::sbt_reverse_rank_(other.node) - size_balanced_tree::sbt_reverse_rank_(node);
         }
         const_reverse_iterator &operator++()
         {
@@ -509,7 +575,7 @@ public:
         insert(begin, end);
     }
     //copy
-    size_balanced_tree(size_balanced_tree const &other) : size_balanced_tree(other.get_comparator_(), other.get_root_allocator_(), other.get_node_allocator_())
+    size_balanced_tree(size_balanced_tree const &other) : size_balanced_tree(other.get_comparator_(), std::allocator_traits<node_allocator_t>::select_on_container_copy_construction(other.get_node_allocator_()))
     {
         sbt_copy_<std::false_type>(nullptr, other.get_root_());
     }
@@ -551,12 +617,11 @@ public:
         {
             return *this;
         }
-        if(get_node_allocator_() == other.get_node_allocator_())
+        if(!std::allocator_traits<node_allocator_t>::propagate_on_container_copy_assignment::value || get_node_allocator_() == other.get_node_allocator_())
         {
             size_balanced_tree tree_memory(get_comparator_(), get_root_allocator_(), get_node_allocator_());
             std::swap(head_.root, tree_memory.head_.root);
             get_comparator_() = other.get_comparator_();
-            get_node_allocator_() = other.get_node_allocator_();
             sbt_copy_<std::false_type>(&tree_memory, other.get_root_());
         }
         else
@@ -594,7 +659,7 @@ public:
             tree_memory.sbt_erase_<true>(node);
             get_node_allocator_().destroy(node);
             get_node_allocator_().construct(node, *it++);
-            sbt_insert_hint_(nil_(), node);
+            sbt_insert_node_(nil_(), node);
         }
         insert(it, il.end());
         return *this;
@@ -605,6 +670,11 @@ public:
         return *head_.root;
     }
 
+    key_compare key_comp() const
+    {
+        return get_comparator_();
+    }
+
     void swap(size_balanced_tree &other)
     {
         std::swap(head_, other.head_);
@@ -612,34 +682,53 @@ public:
 
     typedef std::pair<iterator, iterator> pair_ii_t;
     typedef std::pair<const_iterator, const_iterator> pair_cici_t;
+    typedef std::pair<iterator, bool> pair_ib_t;
+    typedef typename std::conditional<unique_select_t::value, pair_ib_t, iterator>::type insert_result_t;
+
+protected:
+    typedef std::pair<node_t *, bool> pair_nb_t;
+    static insert_result_t result_(pair_nb_t result, std::true_type)
+    {
+        return pair_ib_t(iterator(result.first), result.second);
+    }
+    static insert_result_t result_(pair_nb_t result, std::false_type)
+    {
+        return iterator(result.first);
+    }
 
-    //single element
-    iterator insert(value_type const &value)
+public:
+    //single element, unique keys look up before the node is created
+    insert_result_t insert(value_type const &value)
     {
         check_max_size_();
-        return iterator(sbt_insert_<false>(sbt_create_node_(value)));
+        return result_(sbt_insert_value_(value, unique_select_t()), unique_select_t());
     }
-    //single element
-    template<class in_value_t> typename std::enable_if<std::is_convertible<in_value_t, value_type>::value, iterator>::type insert(in_value_t &&value)
+    //single element, unique keys look up before the node is created
+    template<class in_value_t> typename std::enable_if<std::is_convertible<in_value_t, value_type>::value, insert_result_t>::type insert(in_value_t &&value)
     {
         check_max_size_();
-        return iterator(sbt_insert_<false>(sbt_create_node_(std::forward<in_value_t>(value))));
+        return result_(sbt_insert_value_(std::forward<in_value_t>(value), unique_select_t()), unique_select_t());
     }
     //with hint
     iterator insert(const_iterator hint, value_type const &value)
     {
         check_max_size_();
-        return iterator(sbt_insert_hint_(hint.node, sbt_create_node_(value)));
+        return iterator(sbt_insert_node_(hint.node, sbt_create_node_(value)).first);
     }
     //with hint
     template<class in_value_t> typename std::enable_if<std::is_convertible<in_value_t, value_type>::value, iterator>::type insert(const_iterator hint, in_value_t &&value)
     {
         check_max_size_();
-        return iterator(sbt_insert_hint_(hint.node, sbt_create_node_(std::forward<in_value_t>(value))));
+        return iterator(sbt_insert_node_(hint.node, sbt_create_node_(std::forward<in_value_t>(value))).first);
     }
-    //range
+    //range, an empty tree fed with sorted input is built balanced in O(n)
     template<class iterator_t> void insert(iterator_t begin, iterator_t end)
     {
+        if(empty())
+        {
+            sbt_build_(begin, end);
+            return;
+        }
         for(; begin != end; ++begin)
         {
             emplace_hint(cend(), *begin);
@@ -651,17 +740,53 @@ public:
         insert(il.begin(), il.end());
     }
 
-    //single element
-    template<class ...args_t> iterator emplace(args_t &&...args)
+    //single element, unique keys destroy the node when key exists
+    template<class ...args_t> insert_result_t emplace(args_t &&...args)
     {
         check_max_size_();
-        return iterator(sbt_insert_<false>(sbt_create_node_(std::forward<args_t>(args)...)));
+        return result_(sbt_insert_node_(sbt_create_node_(std::forward<args_t>(args)...)), unique_select_t());
     }
     //with hint
     template<class ...args_t> iterator emplace_hint(const_iterator hint, args_t &&...args)
     {
         check_max_size_();
-        return iterator(sbt_insert_hint_(hint.node, sbt_create_node_(std::forward<args_t>(args)...)));
+        return iterator(sbt_insert_node_(hint.node, sbt_create_node_(std::forward<args_t>(args)...)).first);
+    }
+
+    //unique map only, mapped_type is constructed from args only if key is absent, one descent
+    template<class in_key_t, class ...args_t> typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && unique_select_t::value && !std::is_same<typename std::remove_const<value_type>::type, key_type>::value, pair_ib_t>::type try_emplace(in_key_t &&key, args_t &&...args)
+    {
+        check_max_size_();
+        node_t *where;
+        bool is_left;
+        node_t *found = bst_unique_position_(key, where, is_left);
+        if(found != nullptr)
+        {
+            return pair_ib_t(iterator(found), false);
+        }
+        node_t *node = sbt_create_node_(std::piecewise_construct, std::forward_as_tuple(std::forward<in_key_t>(key)), std::forward_as_tuple(std::forward<args_t>(args)...));
+        sbt_insert_slot_(where, is_left, node);
+        return pair_ib_t(iterator(node), true);
+    }
+    //unique map only, key right before hint skips the descent
+    template<class in_key_t, class ...args_t> typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && unique_select_t::value && !std::is_same<typename std::remove_const<value_type>::type, key_type>::value, iterator>::type try_emplace(const_iterator hint, in_key_t &&key, args_t &&...args)
+    {
+        check_max_size_();
+        node_t *where;
+        bool is_left;
+        node_t *found = bst_unique_position_(hint.node, key, where, is_left);
+        if(found != nullptr)
+        {
+            return iterator(found);
+        }
+        node_t *node = sbt_create_node_(std::piecewise_construct, std::forward_as_tuple(std::forward<in_key_t>(key)), std::forward_as_tuple(std::forward<args_t>(args)...));
+        sbt_insert_slot_(where, is_left, node);
+        return iterator(node);
+    }
+    //unique map only
+    template<class in_key_t, class = typename std::enable_if<std::is_convertible<in_key_t, key_type>::value && unique_select_t::value && !std::is_same<typename std::remove_const<value_type>::type, key_type>::value, void>::type> mapped_type &operator[](in_key_t &&key)
+    {
+        return try_emplace(std::forward<in_key_t>(key)).first->second;
     }
 
     iterator find(key_type const &key)
@@ -684,15 +809,10 @@ public:
     }
     size_type erase(key_type const &key)
     {
-        size_type erase_count = 0;
-        node_t *where = bst_lower_bound_(key);
-        while(!is_nil_(where) && !get_comparator_()(key, get_key_(where)))
-        {
-            node_t *next = bst_move_<true>(where);
-            erase(iterator(where));
-            where = next;
-            ++erase_count;
-        }
+        node_t *lower, *upper;
+        std::tie(lower, upper) = bst_equal_range_(key);
+        size_type erase_count = sbt_rank_(upper) - sbt_rank_(lower);
+        erase(const_iterator(lower), const_iterator(upper));
         return erase_count;
     }
     iterator erase(const_iterator erase_begin, const_iterator erase_end)
@@ -702,14 +822,19 @@ public:
             clear();
             return begin();
         }
-        else
+        size_type index_begin = sbt_rank_(erase_begin.node), index_end = sbt_rank_(erase_end.node);
+        if(index_end - index_begin < 16)
         {
             while(erase_begin != erase_end)
             {
                 erase(erase_begin++);
             }
-            return iterator(erase_begin.node);
         }
+        else
+        {
+            sbt_erase_range_(index_begin, index_end);
+        }
+        return iterator(erase_end.node);
     }
 
     size_type count(key_type const &key) const
@@ -884,7 +1009,7 @@ public:
     void clear()
     {
         sbt_clear_(get_root_());
-        set_root_(nil_());
+        sbt_attach_(nil_());
     }
     size_type size() const
     {
@@ -917,6 +1042,22 @@ public:
         return sbt_rank_(where.node);
     }
 
+    //rank_begin..rank_end sorted ascending, out gets at(rank) for each, one shared descent, O(m * log(n / m))
+    template<class in_iterator_t, class out_iterator_t> out_iterator_t select_batch(in_iterator_t rank_begin, in_iterator_t rank_end, out_iterator_t out)
+    {
+        return sbt_select_batch_<iterator>(rank_begin, rank_end, out);
+    }
+    //rank_begin..rank_end sorted ascending, out gets at(rank) for each, one shared descent, O(m * log(n / m))
+    template<class in_iterator_t, class out_iterator_t> out_iterator_t select_batch(in_iterator_t rank_begin, in_iterator_t rank_end, out_iterator_t out) const
+    {
+        return sbt_select_batch_<const_iterator>(rank_begin, rank_end, out);
+    }
+    //key_begin..key_end sorted by key_compare, out gets rank(key) for each, one shared descent, O(m * log(n / m))
+    template<class in_iterator_t, class out_iterator_t> out_iterator_t rank_batch(in_iterator_t key_begin, in_iterator_t key_end, out_iterator_t out) const
+    {
+        return sbt_rank_batch_(get_root_(), 0, key_begin, key_end, out);
+    }
+
     //rank(begin) == 0, key rank current best
     size_type lower_rank(key_type const &key) const
     {
@@ -928,8 +1069,94 @@ public:
         return bst_upper_rank_(key);
     }
 
+    //elements from rank on move to the returned tree, O(log n), nodes are relinked not copied
+    size_balanced_tree split_at(size_type rank)
+    {
+        size_balanced_tree other(get_comparator_(), get_root_allocator_(), get_node_allocator_());
+        if(rank >= size())
+        {
+            return other;
+        }
+        node_t *root = get_root_();
+        set_root_(nil_());
+        std::pair<node_t *, node_t *> part = sbt_split_(root, rank);
+        sbt_attach_(part.first);
+        other.sbt_attach_(part.second);
+        return other;
+    }
+    //append all elements of other, which becomes empty, keys of other must not be less than keys here
+    //O(log n) when node allocators compare equal, otherwise elements are moved one by one
+    void concat(size_balanced_tree &other)
+    {
+        if(this == &other || other.empty())
+        {
+            return;
+        }
+        if(size() + other.size() >= max_size() - 1)
+        {
+            throw std::length_error("sbtree too long");
+        }
+        if(!(get_node_allocator_() == other.get_node_allocator_()))
+        {
+            for(auto &value : other)
+            {
+                emplace_hint(cend(), std::move(value));
+            }
+            other.clear();
+            return;
+        }
+        node_t *middle = other.get_most_left_();
+        other.sbt_erase_<false>(middle);
+        node_t *left = get_root_(), *right = other.get_root_();
+        other.sbt_attach_(other.nil_());
+        set_root_(nil_());
+        sbt_attach_(sbt_join_(left, middle, right));
+    }
+    void concat(size_balanced_tree &&other)
+    {
+        concat(other);
+    }
+
+    //config_t::augment_type only, aggregate of all elements, O(1)
+    aggregate_type aggregate() const
+    {
+        static_assert(augment_select_t::value, "config_t::augment_type required");
+        return sbt_aggregate_(get_root_());
+    }
+    //config_t::augment_type only, aggregate of [range_begin, range_end) in order, O(log n)
+    aggregate_type aggregate(const_iterator range_begin, const_iterator range_end) const
+    {
+        static_assert(augment_select_t::value, "config_t::augment_type required");
+        size_type index_begin = sbt_rank_(range_begin.node), index_end = sbt_rank_(range_end.node);
+        if(index_begin >= index_end)
+        {
+            return augment_policy_t::identity();
+        }
+        return sbt_aggregate_range_(get_root_(), index_begin, index_end);
+    }
+    //config_t::augment_type only, update(mapped_type &) writes the mapped value of where, the aggregates above it are refreshed, O(log n)
+    template<class update_t> void update(const_iterator where, update_t &&proc)
+    {
+        static_assert(augment_select_t::value, "config_t::augment_type required");
+        proc(static_cast<value_node_t *>(where.node)->value.second);
+        sbt_refresh_aggregate_path_(where.node);
+    }
+    //config_t::augment_type only, visit(value_type const &) in order for [range_begin, range_end)
+    //a subtree is skipped as a whole when prune(aggregate_type const &) is true for its aggregate
+    //O(log n + k * log n) when prune only passes subtrees holding a wanted element, e.g. interval stabbing
+    template<class prune_t, class visit_t> void search(const_iterator range_begin, const_iterator range_end, prune_t &&prune, visit_t &&visit) const
+    {
+        static_assert(augment_select_t::value, "config_t::augment_type required");
+        size_type index_begin = sbt_rank_(range_begin.node), index_end = sbt_rank_(range_end.node);
+        if(index_begin < index_end)
+        {
+            sbt_search_(get_root_(), index_begin, index_end, prune, visit);
+        }
+    }
+
 protected:
     head_t head_;
+    static node_t leaf_node_;
 
 protected:
     key_compare &get_comparator_()
@@ -964,6 +1191,17 @@ protected:
         return head_.root;
     }
 
+    static node_t *get_node_(const_iterator where)
+    {
+        return where.node;
+    }
+
+    //children of leaves, shared by all trees so subtrees can move between trees without touching their leaves
+    static node_t *leaf_()
+    {
+        return &leaf_node_;
+    }
+
     node_t *get_root_() const
     {
         return get_parent_(nil_());
@@ -1047,6 +1285,108 @@ protected:
     void sbt_refresh_size_(node_t *node)
     {
         set_size_(node, get_size_(get_left_(node)) + get_size_(get_right_(node)) + 1);
+        sbt_refresh_aggregate_(node);
+    }
+
+    static aggregate_type sbt_aggregate_(node_t *node)
+    {
+        return sbt_aggregate_(node, augment_select_t());
+    }
+    //leaf_node_ and the head are plain node_t, tested before the cast
+    static aggregate_type sbt_aggregate_(node_t *node, std::true_type)
+    {
+        if(node == leaf_() || is_nil_(node))
+        {
+            return augment_policy_t::identity();
+        }
+        return static_cast<value_node_t *>(node)->aggregate;
+    }
+    static aggregate_type sbt_aggregate_(node_t *, std::false_type)
+    {
+        return aggregate_type();
+    }
+
+    //children must be up to date
+    static void sbt_refresh_aggregate_(node_t *node)
+    {
+        sbt_refresh_aggregate_(node, augment_select_t());
+    }
+    static void sbt_refresh_aggregate_(node_t *node, std::true_type)
+    {
+        value_node_t *value_node = static_cast<value_node_t *>(node);
+        value_node->aggregate = augment_policy_t::combine(augment_policy_t::combine(sbt_aggregate_(get_left_(node)), augment_policy_t::lift(value_node->value)), sbt_aggregate_(get_right_(node)));
+    }
+    static void sbt_refresh_aggregate_(node_t *, std::false_type)
+    {
+    }
+
+    //node and its ancestors, up to the first size 0 node
+    static void sbt_refresh_aggregate_path_(node_t *node)
+    {
+        if(augment_select_t::value)
+        {
+            for(; !is_nil_(node); node = get_parent_(node))
+            {
+                sbt_refresh_aggregate_(node);
+            }
+        }
+    }
+
+    static void sbt_copy_aggregate_(node_t *node, node_t *other)
+    {
+        sbt_copy_aggregate_(node, other, augment_select_t());
+    }
+    static void sbt_copy_aggregate_(node_t *node, node_t *other, std::true_type)
+    {
+        static_cast<value_node_t *>(node)->aggregate = static_cast<value_node_t *>(other)->aggregate;
+    }
+    static void sbt_copy_aggregate_(node_t *, node_t *, std::false_type)
+    {
+    }
+
+    //[index_begin, index_end) relative to node, subtrees covered as a whole give their aggregate, only two paths go down
+    static aggregate_type sbt_aggregate_range_(node_t *node, size_type index_begin, size_type index_end)
+    {
+        if(index_begin == 0 && index_end >= get_size_(node))
+        {
+            return sbt_aggregate_(node);
+        }
+        size_type left_size = get_size_(get_left_(node));
+        aggregate_type result = augment_policy_t::identity();
+        if(index_begin < left_size)
+        {
+            result = sbt_aggregate_range_(get_left_(node), index_begin, std::min(index_end, left_size));
+        }
+        if(index_begin <= left_size && left_size < index_end)
+        {
+            result = augment_policy_t::combine(result, augment_policy_t::lift(static_cast<value_node_t *>(node)->value));
+        }
+        if(index_end > left_size + 1)
+        {
+            result = augment_policy_t::combine(result, sbt_aggregate_range_(get_right_(node), index_begin > left_size + 1 ? index_begin - left_size - 1 : 0, index_end - left_size - 1));
+        }
+        return result;
+    }
+
+    template<class prune_t, class visit_t> static void sbt_search_(node_t *node, size_type index_begin, size_type index_end, prune_t &prune, visit_t &visit)
+    {
+        if(is_nil_(node) || prune(static_cast<aggregate_type const &>(static_cast<value_node_t *>(node)->aggregate)))
+        {
+            return;
+        }
+        size_type left_size = get_size_(get_left_(node));
+        if(index_begin < left_size)
+        {
+            sbt_search_(get_left_(node), index_begin, std::min(index_end, left_size), prune, visit);
+        }
+        if(index_begin <= left_size && left_size < index_end)
+        {
+            visit(static_cast<value_type const &>(static_cast<value_node_t *>(node)->value));
+        }
+        if(index_end > left_size + 1)
+        {
+            sbt_search_(get_right_(node), index_begin > left_size + 1 ? index_begin - left_size - 1 : 0, index_end - left_size - 1, prune, visit);
+        }
     }
 
     template<bool is_left> static void set_child_(node_t *node, node_t *child)
@@ -1076,9 +1416,10 @@ protected:
     void bst_init_node_(node_t *parent, node_t *node)
     {
         set_parent_(node, parent);
-        set_left_(node, nil_());
-        set_right_(node, nil_());
+        set_left_(node, leaf_());
+        set_right_(node, leaf_());
         set_size_(node, 1);
+        sbt_refresh_aggregate_(node);
     }
 
     template<bool is_next> static node_t *bst_move_(node_t *node)
@@ -1192,6 +1533,72 @@ protected:
         return std::make_pair(lower, upper);
     }
 
+    //ranks past the end go to end, the rest walk down together
+    template<class result_iterator_t, class in_iterator_t, class out_iterator_t> out_iterator_t sbt_select_batch_(in_iterator_t rank_begin, in_iterator_t rank_end, out_iterator_t out) const
+    {
+        in_iterator_t rank_split = std::lower_bound(rank_begin, rank_end, size());
+        out = sbt_select_batch_<result_iterator_t>(get_root_(), 0, rank_begin, rank_split, out);
+        for(; rank_split != rank_end; ++rank_split)
+        {
+            *out = result_iterator_t(nil_());
+            ++out;
+        }
+        return out;
+    }
+
+    //rank_begin..rank_end are in [offset, offset + size of node)
+    template<class result_iterator_t, class in_iterator_t, class out_iterator_t> static out_iterator_t sbt_select_batch_(node_t *node, size_type offset, in_iterator_t rank_begin, in_iterator_t rank_end, out_iterator_t out)
+    {
+        while(rank_begin != rank_end)
+        {
+            size_type rank = offset + get_size_(get_left_(node));
+            in_iterator_t rank_split = std::lower_bound(rank_begin, rank_end, rank);
+            if(rank_split != rank_begin)
+            {
+                out = sbt_select_batch_<result_iterator_t>(get_left_(node), offset, rank_begin, rank_split, out);
+            }
+            for(; rank_split != rank_end && size_type(*rank_split) == rank; ++rank_split)
+            {
+                *out = result_iterator_t(node);
+                ++out;
+            }
+            rank_begin = rank_split;
+            offset = rank + 1;
+            node = get_right_(node);
+        }
+        return out;
+    }
+
+    //keys not greater than node go left, the rest go right
+    template<class in_iterator_t, class out_iterator_t> out_iterator_t sbt_rank_batch_(node_t *node, size_type offset, in_iterator_t key_begin, in_iterator_t key_end, out_iterator_t out) const
+    {
+        while(key_begin != key_end)
+        {
+            if(is_nil_(node))
+            {
+                for(; key_begin != key_end; ++key_begin)
+                {
+                    *out = offset;
+                    ++out;
+                }
+                break;
+            }
+            node_t *current = node;
+            in_iterator_t key_split = std::partition_point(key_begin, key_end, [this, current](typename std::iterator_traits<in_iterator_t>::value_type const &key)
+            {
+                return !get_comparator_()(get_key_(current), key);
+            });
+            if(key_split != key_begin)
+            {
+                out = sbt_rank_batch_(get_left_(node), offset, key_begin, key_split, out);
+            }
+            key_begin = key_split;
+            offset += get_size_(get_left_(node)) + 1;
+            node = get_right_(node);
+        }
+        return out;
+    }
+
     node_t *sbt_at_(size_type index)
     {
         node_t *node = get_root_();
@@ -1327,6 +1734,12 @@ protected:
         return rank;
     }
 
+    //rank with end before begin, reverse iterators count from it
+    static difference_type sbt_reverse_rank_(node_t *node)
+    {
+        return is_nil_(node) ? -1 : static_cast<difference_type>(sbt_rank_(node));
+    }
+
     size_type bst_lower_rank_(key_type const &key) const
     {
         node_t *node = get_root_();
@@ -1389,12 +1802,17 @@ protected:
         set_child_<is_left>(child, node);
         set_parent_(node, child);
         set_size_(child, get_size_(node));
+        sbt_copy_aggregate_(child, node);
         sbt_refresh_size_(node);
         return child;
     }
 
     template<bool is_left> node_t *sbt_maintain_(node_t *node)
     {
+        if(top_down_select_t::value)
+        {
+            return sbt_weight_maintain_<is_left>(node);
+        }
         if(is_nil_(get_child_<is_left>(node)))
         {
             return node;
@@ -1428,6 +1846,29 @@ protected:
         return node;
     }
 
+    //top_down_type, the child on is_left side may be too heavy, same rotations as the descent
+    //one step fixes an insert or erase below, join moves whole subtrees so the nodes moved down are checked again
+    template<bool is_left> node_t *sbt_weight_maintain_(node_t *node)
+    {
+        node_t *child = get_child_<is_left>(node);
+        if(2 * (get_size_(child) + 1) <= 5 * (get_size_(get_child_<!is_left>(node)) + 1))
+        {
+            return node;
+        }
+        if(2 * (get_size_(get_child_<!is_left>(child)) + 1) < 3 * (get_size_(get_child_<is_left>(child)) + 1))
+        {
+            node = sbt_rotate_<!is_left>(node);
+        }
+        else
+        {
+            sbt_rotate_<is_left>(child);
+            node = sbt_rotate_<!is_left>(node);
+        }
+        sbt_weight_maintain_<false>(sbt_weight_maintain_<true>(get_left_(node)));
+        sbt_weight_maintain_<false>(sbt_weight_maintain_<true>(get_right_(node)));
+        return sbt_weight_maintain_<false>(sbt_weight_maintain_<true>(node));
+    }
+
     void check_max_size_()
     {
         if(size() >= max_size() - 1)
@@ -1443,6 +1884,114 @@ protected:
         return node;
     }
 
+    template<class iterator_t> static void sbt_reserve_(std::vector<node_t *> &, iterator_t, iterator_t, std::input_iterator_tag)
+    {
+    }
+    template<class iterator_t> static void sbt_reserve_(std::vector<node_t *> &node, iterator_t begin, iterator_t end, std::forward_iterator_tag)
+    {
+        node.reserve(std::distance(begin, end));
+    }
+
+    //empty tree only, nodes are created first, sorted input is linked bottom up, otherwise inserted one by one
+    //unique keys drop equal neighbours of sorted input before linking
+    template<class iterator_t> void sbt_build_(iterator_t begin, iterator_t end)
+    {
+        std::vector<node_t *> node;
+        try
+        {
+            sbt_reserve_(node, begin, end, typename std::iterator_traits<iterator_t>::iterator_category());
+            for(; begin != end; ++begin)
+            {
+                if(node.size() >= max_size() - 1)
+                {
+                    throw std::length_error("sbtree too long");
+                }
+                node.emplace_back(nullptr);
+                node.back() = sbt_create_node_(*begin);
+            }
+        }
+        catch(...)
+        {
+            for(node_t *item : node)
+            {
+                if(item != nullptr)
+                {
+                    sbt_destroy_node_(item);
+                }
+            }
+            throw;
+        }
+        if(node.empty())
+        {
+            return;
+        }
+        size_type linked = 0;
+        try
+        {
+            for(size_type i = 1; i < node.size(); ++i)
+            {
+                if(get_comparator_()(get_key_(node[i]), get_key_(node[i - 1])))
+                {
+                    for(; linked < node.size(); ++linked)
+                    {
+                        sbt_insert_node_(nil_(), node[linked]);
+                    }
+                    return;
+                }
+            }
+            if(unique_select_t::value)
+            {
+                size_type kept = 1;
+                for(size_type i = 1; i < node.size(); ++i)
+                {
+                    if(get_comparator_()(get_key_(node[kept - 1]), get_key_(node[i])))
+                    {
+                        node_t *item = node[i];
+                        node[i] = nullptr;
+                        node[kept++] = item;
+                    }
+                    else
+                    {
+                        sbt_destroy_node_(node[i]);
+                        node[i] = nullptr;
+                    }
+                }
+                node.resize(kept);
+            }
+        }
+        catch(...)
+        {
+            for(; linked < node.size(); ++linked)
+            {
+                if(node[linked] != nullptr)
+                {
+                    sbt_destroy_node_(node[linked]);
+                }
+            }
+            throw;
+        }
+        set_root_(sbt_build_uncheck_(nil_(), node.data(), node.size()));
+        set_most_left_(node.front());
+        set_most_right_(node.back());
+    }
+
+    //middle node as root, sibling sizes differ by at most one so every size balance condition holds
+    node_t *sbt_build_uncheck_(node_t *parent, node_t *const *node, size_type count)
+    {
+        if(count == 0)
+        {
+            return leaf_();
+        }
+        size_type middle = count / 2;
+        node_t *root = node[middle];
+        set_parent_(root, parent);
+        set_size_(root, count);
+        set_left_(root, sbt_build_uncheck_(root, node, middle));
+        set_right_(root, sbt_build_uncheck_(root, node + middle + 1, count - middle - 1));
+        sbt_refresh_aggregate_(root);
+        return root;
+    }
+
     template<bool is_leftish> node_t *sbt_insert_(node_t *key)
     {
         if(is_nil_(get_root_()))
@@ -1453,6 +2002,11 @@ protected:
             set_most_right_(key);
             return key;
         }
+        if(top_down_select_t::value)
+        {
+            sbt_insert_top_down_<is_leftish>(key);
+            return key;
+        }
         node_t *node = get_root_(), *where = nil_();
         bool is_left = true;
         while(!is_nil_(node))
@@ -1480,6 +2034,71 @@ protected:
         return key;
     }
 
+    //top_down_type keeps every node weight balanced, weight = size + 1, 2 * w(child) <= 5 * w(sibling), depth <= log(n + 1) / log(7 / 5)
+    //sizes along the path already count key, a child about to break that is rotated up before the descent enters it
+    //single rotation when 2 * w(inner) < 3 * w(outer) after the insert, else double, the bottom up <5/2, 3/2> choice
+    //every case leaves the new top balanced after the insert and the nodes moved below it balanced before it (all weights up to 600 checked)
+    //so the descent goes on from the new top and nothing above it is touched again
+    //aggregates are still those of the tree without key while descending, so only the final path needs a refresh
+    template<bool is_leftish> void sbt_insert_top_down_(node_t *key)
+    {
+        node_t *node = get_root_();
+        set_size_(node, get_size_(node) + 1);
+        while(true)
+        {
+            bool is_left = sbt_insert_is_left_<is_leftish>(node, key);
+            node_t *child = is_left ? get_left_(node) : get_right_(node);
+            if(is_nil_(child))
+            {
+                sbt_link_(is_left, node, key);
+                sbt_refresh_aggregate_path_(node);
+                return;
+            }
+            //w(sibling) = size(node) - w(child) as size(node) already counts key, the sibling itself is never loaded
+            if(2 * (get_size_(child) + 2) <= 5 * (get_size_(node) - get_size_(child) - 1))
+            {
+                size_balanced_tree_detail::prefetch(get_left_(child));
+                size_balanced_tree_detail::prefetch(get_right_(child));
+                set_size_(child, get_size_(child) + 1);
+                node = child;
+                continue;
+            }
+            bool is_child_left = sbt_insert_is_left_<is_leftish>(child, key);
+            node_t *outer = is_left ? get_left_(child) : get_right_(child);
+            node_t *inner = is_left ? get_right_(child) : get_left_(child);
+            if(2 * (get_size_(inner) + 1 + (is_child_left != is_left)) < 3 * (get_size_(outer) + 1 + (is_child_left == is_left)))
+            {
+                node = is_left ? sbt_rotate_<false>(node) : sbt_rotate_<true>(node);
+            }
+            else if(is_nil_(inner))
+            {
+                set_size_(child, get_size_(child) + 1);
+                sbt_link_(is_child_left, child, key);
+                sbt_refresh_aggregate_path_(child);
+                is_left ? sbt_rotate_<true>(child) : sbt_rotate_<false>(child);
+                is_left ? sbt_rotate_<false>(node) : sbt_rotate_<true>(node);
+                return;
+            }
+            else
+            {
+                is_left ? sbt_rotate_<true>(child) : sbt_rotate_<false>(child);
+                node = is_left ? sbt_rotate_<false>(node) : sbt_rotate_<true>(node);
+            }
+        }
+    }
+
+    template<bool is_leftish> bool sbt_insert_is_left_(node_t *node, node_t *key)
+    {
+        if(is_leftish)
+        {
+            return !get_comparator_()(get_key_(node), get_key_(key));
+        }
+        else
+        {
+            return get_comparator_()(get_key_(key), get_key_(node));
+        }
+    }
+
     node_t *sbt_insert_hint_(node_t *where, node_t *key)
     {
         bool is_leftish = false;
@@ -1559,6 +2178,13 @@ protected:
             }
             while(!is_nil_(parent = get_parent_(parent)));
         }
+        sbt_link_(is_left, where, node);
+        sbt_insert_maintain_(where, node);
+    }
+
+    //node becomes a leaf child of where, sizes above are not touched
+    void sbt_link_(bool is_left, node_t *where, node_t *node)
+    {
         bst_init_node_(where, node);
         if(is_left)
         {
@@ -1576,11 +2202,289 @@ protected:
                 set_most_right_(node);
             }
         }
-        sbt_insert_maintain_(where, node);
     }
 
+    //multi keys always link node, unique keys destroy node when its key exists, return the node holding the key and whether node was linked
+    pair_nb_t sbt_insert_node_(node_t *node)
+    {
+        return sbt_insert_node_(node, unique_select_t());
+    }
+    pair_nb_t sbt_insert_node_(node_t *node, std::false_type)
+    {
+        return pair_nb_t(sbt_insert_<false>(node), true);
+    }
+    pair_nb_t sbt_insert_node_(node_t *node, std::true_type)
+    {
+        node_t *where;
+        bool is_left;
+        node_t *found = bst_unique_position_(get_key_(node), where, is_left);
+        if(found != nullptr)
+        {
+            sbt_destroy_node_(node);
+            return pair_nb_t(found, false);
+        }
+        sbt_insert_slot_(where, is_left, node);
+        return pair_nb_t(node, true);
+    }
+    pair_nb_t sbt_insert_node_(node_t *hint, node_t *node)
+    {
+        return sbt_insert_node_(hint, node, unique_select_t());
+    }
+    pair_nb_t sbt_insert_node_(node_t *hint, node_t *node, std::false_type)
+    {
+        return pair_nb_t(sbt_insert_hint_(hint, node), true);
+    }
+    pair_nb_t sbt_insert_node_(node_t *hint, node_t *node, std::true_type)
+    {
+        node_t *where;
+        bool is_left;
+        node_t *found = bst_unique_position_(hint, get_key_(node), where, is_left);
+        if(found != nullptr)
+        {
+            sbt_destroy_node_(node);
+            return pair_nb_t(found, false);
+        }
+        sbt_insert_slot_(where, is_left, node);
+        return pair_nb_t(node, true);
+    }
+
+    template<class in_value_t> pair_nb_t sbt_insert_value_(in_value_t &&value, std::false_type)
+    {
+        return pair_nb_t(sbt_insert_<false>(sbt_create_node_(std::forward<in_value_t>(value))), true);
+    }
+    template<class in_value_t> pair_nb_t sbt_insert_value_(in_value_t &&value, std::true_type)
+    {
+        return sbt_insert_unique_value_(std::forward<in_value_t>(value), std::is_same<typename std::decay<in_value_t>::type, typename std::remove_cv<value_type>::type>());
+    }
+    //only convertible to value_type, the key exists after the node is built
+    template<class in_value_t> pair_nb_t sbt_insert_unique_value_(in_value_t &&value, std::false_type)
+    {
+        return sbt_insert_node_(sbt_create_node_(std::forward<in_value_t>(value)));
+    }
+    //an existing key costs one descent and no allocation
+    template<class in_value_t> pair_nb_t sbt_insert_unique_value_(in_value_t &&value, std::true_type)
+    {
+        node_t *where;
+        bool is_left;
+        node_t *found = bst_unique_position_(config_t::get_key(value), where, is_left);
+        if(found != nullptr)
+        {
+            return pair_nb_t(found, false);
+        }
+        node_t *node = sbt_create_node_(std::forward<in_value_t>(value));
+        sbt_insert_slot_(where, is_left, node);
+        return pair_nb_t(node, true);
+    }
+
+    //node with an equal key, or nullptr and key belongs to the is_left side of where, nil where for an empty tree
+    //nothing changes on the way down, sizes grow only when a node is linked
+    node_t *bst_unique_position_(key_type const &key, node_t *&where, bool &is_left) const
+    {
+        node_t *node = get_root_(), *candidate = nullptr;
+        where = nil_();
+        is_left = true;
+        while(!is_nil_(node))
+        {
+            where = node;
+            is_left = get_comparator_()(key, get_key_(node));
+            if(is_left)
+            {
+                node = get_left_(node);
+            }
+            else
+            {
+                candidate = node;
+                node = get_right_(node);
+            }
+        }
+        if(candidate != nullptr && !get_comparator_()(get_key_(candidate), key))
+        {
+            return candidate;
+        }
+        return nullptr;
+    }
+
+    //key between the node before hint and hint goes next to hint, otherwise one descent
+    node_t *bst_unique_position_(node_t *hint, key_type const &key, node_t *&where, bool &is_left) const
+    {
+        if(!is_nil_(get_root_()) && (hint == nil_() || get_comparator_()(key, get_key_(hint))))
+        {
+            node_t *prev = hint == get_most_left_() ? nullptr : hint == nil_() ? get_most_right_() : bst_move_<false>(hint);
+            if(prev == nullptr || get_comparator_()(get_key_(prev), key))
+            {
+                if(hint != nil_() && is_nil_(get_left_(hint)))
+                {
+                    where = hint;
+                    is_left = true;
+                }
+                else
+                {
+                    where = prev;
+                    is_left = false;
+                }
+                return nullptr;
+            }
+        }
+        return bst_unique_position_(key, where, is_left);
+    }
+
+    //empty slot from bst_unique_position_
+    void sbt_insert_slot_(node_t *where, bool is_left, node_t *node)
+    {
+        if(is_nil_(where))
+        {
+            bst_init_node_(nil_(), node);
+            set_root_(node);
+            set_most_left_(node);
+            set_most_right_(node);
+        }
+        else
+        {
+            sbt_insert_at_<true>(is_left, where, node);
+        }
+    }
+
+    //insert node before where, end appends, no key compare
+    void sbt_insert_before_(node_t *where, node_t *node)
+    {
+        if(is_nil_(get_root_()))
+        {
+            bst_init_node_(nil_(), node);
+            set_root_(node);
+            set_most_left_(node);
+            set_most_right_(node);
+        }
+        else if(is_nil_(where))
+        {
+            sbt_insert_at_<true>(false, get_most_right_(), node);
+        }
+        else if(is_nil_(get_left_(where)))
+        {
+            sbt_insert_at_<true>(true, where, node);
+        }
+        else
+        {
+            sbt_insert_at_<true>(false, bst_move_<false>(where), node);
+        }
+    }
+
+    //cut [index_begin, index_end) out as one subtree, its root joins the rest back as middle node and is erased alone
+    //the other nodes are destroyed without any size fix or maintain
+    void sbt_erase_range_(size_type index_begin, size_type index_end)
+    {
+        node_t *root = get_root_();
+        set_root_(nil_());
+        std::pair<node_t *, node_t *> right = sbt_split_(root, index_end);
+        std::pair<node_t *, node_t *> left = sbt_split_(right.first, index_begin);
+        node_t *middle = left.second;
+        sbt_clear_uncheck_(middle);
+        sbt_attach_(sbt_join_(left.first, middle, right.second));
+        sbt_erase_<false>(middle);
+        sbt_destroy_node_(middle);
+    }
+
+    //root becomes the root of this tree, an empty tree when root is nil
+    void sbt_attach_(node_t *root)
+    {
+        if(is_nil_(root))
+        {
+            set_root_(nil_());
+            set_most_left_(nil_());
+            set_most_right_(nil_());
+            return;
+        }
+        set_parent_(root, nil_());
+        set_root_(root);
+        set_most_left_(bst_most_<true>(root));
+        set_most_right_(bst_most_<false>(root));
+    }
+
+    //detached subtree into the first rank nodes and the rest, both detached
+    std::pair<node_t *, node_t *> sbt_split_(node_t *node, size_type rank)
+    {
+        if(is_nil_(node))
+        {
+            return std::make_pair(leaf_(), leaf_());
+        }
+        node_t *left = get_left_(node), *right = get_right_(node);
+        size_type left_size = get_size_(left);
+        if(rank <= left_size)
+        {
+            std::pair<node_t *, node_t *> part = sbt_split_(left, rank);
+            return std::make_pair(part.first, sbt_join_(part.second, node, right));
+        }
+        else
+        {
+            std::pair<node_t *, node_t *> part = sbt_split_(right, rank - left_size - 1);
+            return std::make_pair(sbt_join_(left, node, part.first), part.second);
+        }
+    }
+
+    //detached subtrees left < middle < right joined into one detached subtree
+    node_t *sbt_join_(node_t *left, node_t *middle, node_t *right)
+    {
+        if(is_nil_(left) && is_nil_(right))
+        {
+            set_left_(middle, leaf_());
+            set_right_(middle, leaf_());
+            set_size_(middle, 1);
+            sbt_refresh_aggregate_(middle);
+            return middle;
+        }
+        if(get_size_(left) >= get_size_(right))
+        {
+            return sbt_join_side_<true>(left, middle, is_nil_(right) ? leaf_() : right);
+        }
+        else
+        {
+            return sbt_join_side_<false>(right, middle, is_nil_(left) ? leaf_() : left);
+        }
+    }
+
+    //big keeps its shape, middle takes the first subtree on the inner spine of big not larger than small, small becomes its sibling
+    //sizes grow on the way down, maintain runs on the way up like an insert, a size 0 holder stops it above big
+    template<bool is_left> node_t *sbt_join_side_(node_t *big, node_t *middle, node_t *small)
+    {
+        node_t holder = {nullptr, big, nullptr, 0};
+        set_parent_(big, &holder);
+        size_type grow = get_size_(small) + 1;
+        node_t *parent = &holder, *node = big;
+        while(get_size_(node) > get_size_(small))
+        {
+            set_size_(node, get_size_(node) + grow);
+            parent = node;
+            node = get_child_<!is_left>(node);
+        }
+        set_child_<is_left>(middle, node);
+        set_child_<!is_left>(middle, small);
+        set_size_(middle, get_size_(node) + grow);
+        set_parent_(middle, parent);
+        if(!is_nil_(node))
+        {
+            set_parent_(node, middle);
+        }
+        if(!is_nil_(small))
+        {
+            set_parent_(small, middle);
+        }
+        if(parent == &holder)
+        {
+            set_left_(&holder, middle);
+        }
+        else
+        {
+            set_child_<!is_left>(parent, middle);
+        }
+        sbt_refresh_aggregate_(middle);
+        node_t *top = sbt_maintain_<!is_left>(middle);
+        sbt_insert_maintain_(get_parent_(top), top);
+        return get_left_(&holder);
+    }
+
+    //aggregates above a new node are refreshed first, rotations keep them right after that
     void sbt_insert_maintain_(node_t *where, node_t *node)
     {
+        sbt_refresh_aggregate_path_(where);
         while(!is_nil_(where))
         {
             if(node == get_left_(where))
@@ -1632,18 +2536,18 @@ protected:
         {
             if(get_size_(get_left_(node)) > get_size_(get_right_(node)))
             {
-                node = sbt_erase_at_<is_clear, true>(node);
+                node = sbt_erase_at_<is_clear, true>(node, is_left);
                 if(!is_clear)
                 {
-                    sbt_erase_maintain_(node, true);
+                    sbt_erase_maintain_(node, is_left);
                 }
             }
             else
             {
-                node = sbt_erase_at_<is_clear, false>(node);
+                node = sbt_erase_at_<is_clear, false>(node, is_left);
                 if(!is_clear)
                 {
-                    sbt_erase_maintain_(node, false);
+                    sbt_erase_maintain_(node, is_left);
                 }
             }
             return;
@@ -1683,7 +2587,8 @@ protected:
         }
     }
 
-    template<bool is_clear, bool is_left> node_t *sbt_erase_at_(node_t *node)
+    //return the node to maintain from, is_fix_left tells which of its sides lost a node
+    template<bool is_clear, bool is_left> node_t *sbt_erase_at_(node_t *node, bool &is_fix_left)
     {
         node_t *erase_node = node;
         node_t *fix_node;
@@ -1703,10 +2608,12 @@ protected:
         if(node == get_child_<is_left>(erase_node))
         {
             fix_node_parent = node;
+            is_fix_left = is_left;
         }
         else
         {
             fix_node_parent = get_parent_(node);
+            is_fix_left = !is_left;
             if(!is_nil_(fix_node))
             {
                 set_parent_(fix_node, fix_node_parent);
@@ -1737,6 +2644,7 @@ protected:
 
     void sbt_erase_maintain_(node_t *where, bool is_left)
     {
+        sbt_refresh_aggregate_path_(where);
         if(is_left)
         {
             where = sbt_maintain_<false>(where);
@@ -1831,8 +2739,8 @@ protected:
     {
         node_t *new_node = sbt_copy_node_(memory, other, is_move());
         set_parent_(new_node, node);
-        set_left_(new_node, nil_());
-        set_right_(new_node, nil_());
+        set_left_(new_node, leaf_());
+        set_right_(new_node, leaf_());
         set_size_(new_node, get_size_(other));
         try
         {
@@ -1844,6 +2752,7 @@ protected:
             {
                 set_right_(new_node, sbt_copy_uncheck_<is_move>(memory, new_node, get_right_(other)));
             }
+            sbt_refresh_aggregate_(new_node);
         }
         catch(...)
         {
@@ -1853,3 +2762,4 @@ protected:
         return new_node;
     }
 };
+template<class config_t> typename size_balanced_tree<config_t>::node_t size_balanced_tree<config_t>::leaf_node_ = {nullptr, nullptr, nullptr, 0};
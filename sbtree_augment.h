@@ -0,0 +1,101 @@
+#pragma once
+
+#include <limits>
+#include "sbtree_map.h"
+#include "sbtree_set.h"
+
+
+//aggregate policies for config_t::augment_type
+//mapped values of a map, keys of a set
+namespace sbtree_augment_detail
+{
+    struct get_mapped_t
+    {
+        template<class value_t> static auto get(value_t const &value) -> decltype((value.second))
+        {
+            return value.second;
+        }
+    };
+    struct get_self_t
+    {
+        template<class value_t> static value_t const &get(value_t const &value)
+        {
+            return value;
+        }
+    };
+}
+
+//sum, prefix sums by key with aggregate(begin(), upper_bound(key))
+template<class type_t, class get_t = sbtree_augment_detail::get_mapped_t>
+struct sbtree_augment_sum
+{
+    typedef type_t type;
+    static type identity()
+    {
+        return type();
+    }
+    template<class value_t> static type lift(value_t const &value)
+    {
+        return get_t::get(value);
+    }
+    static type combine(type const &left, type const &right)
+    {
+        return left + right;
+    }
+};
+
+//max by comparator_t, an interval tree when key is the begin and mapped is the end
+//identity is the numeric_limits end ordered first by comparator_t
+template<class type_t, class get_t = sbtree_augment_detail::get_mapped_t, class comparator_t = std::less<type_t>>
+struct sbtree_augment_max
+{
+    typedef type_t type;
+    static type identity()
+    {
+        return comparator_t()(std::numeric_limits<type>::max(), std::numeric_limits<type>::lowest()) ? std::numeric_limits<type>::max() : std::numeric_limits<type>::lowest();
+    }
+    template<class value_t> static type lift(value_t const &value)
+    {
+        return get_t::get(value);
+    }
+    static type combine(type const &left, type const &right)
+    {
+        return comparator_t()(left, right) ? right : left;
+    }
+};
+
+//size_balanced_tree with a per subtree aggregate, kept by every insert/erase/rotate/split/concat
+//aggregate(begin, end) folds a rank range in O(log n), search(begin, end, prune, visit) skips pruned subtrees
+template<class base_config_t, class policy_t>
+struct sbtree_augment_config_t : public base_config_t
+{
+    typedef policy_t augment_type;
+};
+
+template<class key_t, class value_t, class policy_t, class comparator_t = std::less<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using sbtree_augment_multimap = size_balanced_tree<sbtree_augment_config_t<sbtree_multimap_config_t<key_t, value_t, comparator_t, allocator_t>, policy_t>>;
+template<class key_t, class policy_t, class comparator_t = std::less<key_t>, class allocator_t = std::allocator<key_t>>
+using sbtree_augment_multiset = size_balanced_tree<sbtree_augment_config_t<sbtree_multiset_config_t<key_t, comparator_t, allocator_t>, policy_t>>;
+
+//intervals [key, mapped), max end of every subtree
+template<class key_t, class comparator_t = std::less<key_t>, class allocator_t = std::allocator<std::pair<key_t const, key_t>>>
+using sbtree_interval_multimap = sbtree_augment_multimap<key_t, key_t, sbtree_augment_max<key_t, sbtree_augment_detail::get_mapped_t, comparator_t>, comparator_t, allocator_t>;
+
+//visit(value_type const &) for every interval [key, mapped) of tree holding point, in key order, O(log n + k * log n)
+//ends are ordered by tree.key_comp(), the aggregate must be a max by the same comparator
+template<class tree_t, class visit_t> void sbtree_stab(tree_t const &tree, typename tree_t::key_type const &point, visit_t &&visit)
+{
+    typedef typename tree_t::value_type value_type;
+    typedef typename tree_t::aggregate_type aggregate_type;
+    typename tree_t::key_compare comp = tree.key_comp();
+    tree.search(tree.begin(), tree.upper_bound(point), [&point, &comp](aggregate_type const &end)
+    {
+        return !comp(point, end);
+    }, [&point, &comp, &visit](value_type const &value)
+    {
+        if(comp(point, value.second))
+        {
+            visit(value);
+        }
+    });
+}
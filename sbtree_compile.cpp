@@ -74,6 +74,10 @@ template<class V, class T> void foo_test(T &bp)
 
 void foo()
 {
+    sbtree_map<int, int> bp_0;
+    sbtree_map<std::string, std::string> bp_1;
+    sbtree_map<int, int> const bp_2;
+    sbtree_map<std::string, std::string> const bp_3;
     sbtree_multimap<int, int> bp_4;
     sbtree_multimap<std::string, std::string> bp_5;
     sbtree_multimap<int, int> const bp_6;
@@ -82,7 +86,15 @@ void foo()
     sbtree_multiset<std::string> bp_d;
     sbtree_multiset<int> const bp_e;
     sbtree_multiset<std::string> const bp_f;
+    sbtree_set<int> bp_8;
+    sbtree_set<std::string> bp_9;
+    sbtree_set<int> const bp_a;
+    sbtree_set<std::string> const bp_b;
 
+    foo_test<std::pair<int, int>>(bp_0);
+    foo_test<std::pair<std::string, std::string>>(bp_1);
+    foo_test<std::pair<int, int>>(bp_2);
+    foo_test<std::pair<std::string, std::string>>(bp_3);
     foo_test<std::pair<int, int>>(bp_4);
     foo_test<std::pair<std::string, std::string>>(bp_5);
     foo_test<std::pair<int, int>>(bp_6);
@@ -91,4 +103,11 @@ void foo()
     foo_test<std::string>(bp_d);
     foo_test<int>(bp_e);
     foo_test<std::string>(bp_f);
+    foo_test<int>(bp_8);
+    foo_test<std::string>(bp_9);
+    foo_test<int>(bp_a);
+    foo_test<std::string>(bp_b);
+    bp_0.try_emplace(1, 2);
+    bp_0.try_emplace(bp_0.end(), 1);
+    bp_1["a"] = "b";
 }
\ No newline at end of file
@@ -0,0 +1,638 @@
+#pragma once
+
+#include "sbtree_map.h"
+#include "sbtree_set.h"
+
+
+//immutable size balanced tree, insert/erase return a new version and leave this one as is
+//a new version copies only the O(log n) nodes on the changed path and shares every other subtree
+//nodes are reference counted, a node dies with the last version using it, counts are not thread safe
+//copying a version is O(1), iterators stay valid while the version they came from lives
+template<class config_t>
+class persistent_size_balanced_tree
+{
+public:
+    typedef typename config_t::key_type key_type;
+    typedef typename config_t::mapped_type mapped_type;
+    typedef typename config_t::value_type value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename config_t::key_compare key_compare;
+    typedef typename config_t::allocator_type allocator_type;
+    typedef value_type &reference;
+    typedef value_type const &const_reference;
+    typedef value_type *pointer;
+    typedef value_type const *const_pointer;
+
+protected:
+    typedef size_balanced_tree_detail::unique_select_t<config_t> unique_select_t;
+    struct node_t
+    {
+        template<class ...args_t> node_t(args_t &&...args) : left(nullptr), right(nullptr), size(1), ref(1), value(std::forward<args_t>(args)...)
+        {
+        }
+        node_t *left;
+        node_t *right;
+        size_type size;
+        size_type ref;
+        value_type value;
+    };
+    typedef typename allocator_type::template rebind<node_t>::other node_allocator_t;
+    struct root_t : public key_compare, public node_allocator_t
+    {
+        template<class any_key_compare, class any_allocator_t> root_t(any_key_compare &&comp, any_allocator_t &&alloc) : key_compare(std::forward<any_key_compare>(comp)), node_allocator_t(std::forward<any_allocator_t>(alloc)), root(nullptr)
+        {
+        }
+        node_t *root;
+    };
+
+public:
+    //forward only, keeps the nodes where the path went left, the top is the current node
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename persistent_size_balanced_tree::value_type value_type;
+        typedef typename persistent_size_balanced_tree::difference_type difference_type;
+        typedef typename persistent_size_balanced_tree::const_reference reference;
+        typedef typename persistent_size_balanced_tree::const_pointer pointer;
+    public:
+        const_iterator()
+        {
+        }
+        const_iterator &operator++()
+        {
+            node_t *node = path.back()->right;
+            path.pop_back();
+            for(; node != nullptr; node = node->left)
+            {
+                path.emplace_back(node);
+            }
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator save(*this);
+            ++*this;
+            return save;
+        }
+        reference operator *() const
+        {
+            return path.back()->value;
+        }
+        pointer operator->() const
+        {
+            return &path.back()->value;
+        }
+        bool operator == (const_iterator const &other) const
+        {
+            return path.empty() ? other.path.empty() : !other.path.empty() && path.back() == other.path.back();
+        }
+        bool operator != (const_iterator const &other) const
+        {
+            return !(*this == other);
+        }
+    private:
+        friend class persistent_size_balanced_tree;
+        std::vector<node_t *> path;
+    };
+    typedef const_iterator iterator;
+
+public:
+    //empty
+    persistent_size_balanced_tree() : root_(key_compare(), allocator_type())
+    {
+    }
+    //empty
+    explicit persistent_size_balanced_tree(key_compare const &comp, allocator_type const &alloc = allocator_type()) : root_(comp, alloc)
+    {
+    }
+    //empty
+    explicit persistent_size_balanced_tree(allocator_type const &alloc) : root_(key_compare(), alloc)
+    {
+    }
+    //range, nodes of a version nobody shares are changed in place
+    template<class iterator_t, class = typename std::iterator_traits<iterator_t>::iterator_category> persistent_size_balanced_tree(iterator_t begin, iterator_t end, key_compare const &comp = key_compare(), allocator_type const &alloc = allocator_type()) : root_(comp, alloc)
+    {
+        try
+        {
+            for(; begin != end; ++begin)
+            {
+                insert_here_(*begin);
+            }
+        }
+        catch(...)
+        {
+            release_(root_.root);
+            throw;
+        }
+    }
+    //initializer list
+    persistent_size_balanced_tree(std::initializer_list<value_type> il, key_compare const &comp = key_compare(), allocator_type const &alloc = allocator_type()) : persistent_size_balanced_tree(il.begin(), il.end(), comp, alloc)
+    {
+    }
+    //same version, O(1)
+    persistent_size_balanced_tree(persistent_size_balanced_tree const &other) : root_(other.get_comparator_(), other.get_node_allocator_())
+    {
+        root_.root = acquire_(other.root_.root);
+    }
+    persistent_size_balanced_tree(persistent_size_balanced_tree &&other) : root_(other.get_comparator_(), other.get_node_allocator_())
+    {
+        std::swap(root_.root, other.root_.root);
+    }
+    ~persistent_size_balanced_tree()
+    {
+        release_(root_.root);
+    }
+    persistent_size_balanced_tree &operator = (persistent_size_balanced_tree const &other)
+    {
+        if(this != &other)
+        {
+            persistent_size_balanced_tree(other).swap(*this);
+        }
+        return *this;
+    }
+    persistent_size_balanced_tree &operator = (persistent_size_balanced_tree &&other)
+    {
+        if(this != &other)
+        {
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(persistent_size_balanced_tree &other)
+    {
+        using std::swap;
+        swap(static_cast<key_compare &>(root_), static_cast<key_compare &>(other.root_));
+        swap(static_cast<node_allocator_t &>(root_), static_cast<node_allocator_t &>(other.root_));
+        swap(root_.root, other.root_.root);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return get_node_allocator_();
+    }
+    size_type size() const
+    {
+        return size_(root_.root);
+    }
+    bool empty() const
+    {
+        return root_.root == nullptr;
+    }
+    size_type max_size() const
+    {
+        return node_allocator_t(get_node_allocator_()).max_size();
+    }
+
+    //new version with value added, unique keys give this version back when key exists, O(log n) new nodes
+    persistent_size_balanced_tree insert(value_type const &value) const
+    {
+        return emplace(value);
+    }
+    persistent_size_balanced_tree insert(value_type &&value) const
+    {
+        return emplace(std::move(value));
+    }
+    template<class ...args_t> persistent_size_balanced_tree emplace(args_t &&...args) const
+    {
+        persistent_size_balanced_tree result(*this);
+        result.insert_here_(std::forward<args_t>(args)...);
+        return result;
+    }
+    //new version without every element equal to key, like the mutable tree, this version back when there is none
+    persistent_size_balanced_tree erase(key_type const &key) const
+    {
+        size_type index = lower_rank(key), count = upper_rank(key) - index;
+        if(count == 0)
+        {
+            return *this;
+        }
+        persistent_size_balanced_tree result(*this);
+        for(; count != 0; --count)
+        {
+            result.erase_at_(result.root_.root, index);
+        }
+        return result;
+    }
+    //new version without the element at index, this version back when index >= size
+    persistent_size_balanced_tree erase_at(size_type index) const
+    {
+        persistent_size_balanced_tree result(*this);
+        if(index < size())
+        {
+            result.erase_at_(result.root_.root, index);
+        }
+        return result;
+    }
+
+    const_iterator begin() const
+    {
+        const_iterator it;
+        for(node_t *node = root_.root; node != nullptr; node = node->left)
+        {
+            it.path.emplace_back(node);
+        }
+        return it;
+    }
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    //if(index >= size) return end
+    const_iterator at(size_type index) const
+    {
+        const_iterator it;
+        if(index >= size())
+        {
+            return it;
+        }
+        node_t *node = root_.root;
+        while(true)
+        {
+            size_type left_size = size_(node->left);
+            if(index < left_size)
+            {
+                it.path.emplace_back(node);
+                node = node->left;
+            }
+            else if(index > left_size)
+            {
+                index -= left_size + 1;
+                node = node->right;
+            }
+            else
+            {
+                it.path.emplace_back(node);
+                return it;
+            }
+        }
+    }
+    const_iterator lower_bound(key_type const &key) const
+    {
+        const_iterator it;
+        for(node_t *node = root_.root; node != nullptr; )
+        {
+            if(get_comparator_()(get_key_(node), key))
+            {
+                node = node->right;
+            }
+            else
+            {
+                it.path.emplace_back(node);
+                node = node->left;
+            }
+        }
+        return it;
+    }
+    const_iterator upper_bound(key_type const &key) const
+    {
+        const_iterator it;
+        for(node_t *node = root_.root; node != nullptr; )
+        {
+            if(get_comparator_()(key, get_key_(node)))
+            {
+                it.path.emplace_back(node);
+                node = node->left;
+            }
+            else
+            {
+                node = node->right;
+            }
+        }
+        return it;
+    }
+    const_iterator find(key_type const &key) const
+    {
+        const_iterator it = lower_bound(key);
+        return (it.path.empty() || get_comparator_()(key, get_key_(it.path.back()))) ? end() : it;
+    }
+    size_type count(key_type const &key) const
+    {
+        return upper_rank(key) - lower_rank(key);
+    }
+
+    //rank(begin) == 0, key rank
+    size_type rank(key_type const &key) const
+    {
+        return lower_rank(key);
+    }
+    //rank(begin) == 0, key rank current best
+    size_type lower_rank(key_type const &key) const
+    {
+        size_type rank = 0;
+        for(node_t *node = root_.root; node != nullptr; )
+        {
+            if(get_comparator_()(get_key_(node), key))
+            {
+                rank += size_(node->left) + 1;
+                node = node->right;
+            }
+            else
+            {
+                node = node->left;
+            }
+        }
+        return rank;
+    }
+    //rank(begin) == 0, key rank when insert
+    size_type upper_rank(key_type const &key) const
+    {
+        size_type rank = 0;
+        for(node_t *node = root_.root; node != nullptr; )
+        {
+            if(get_comparator_()(key, get_key_(node)))
+            {
+                node = node->left;
+            }
+            else
+            {
+                rank += size_(node->left) + 1;
+                node = node->right;
+            }
+        }
+        return rank;
+    }
+
+protected:
+    root_t root_;
+
+protected:
+    key_compare const &get_comparator_() const
+    {
+        return root_;
+    }
+    node_allocator_t &get_node_allocator_()
+    {
+        return root_;
+    }
+    node_allocator_t const &get_node_allocator_() const
+    {
+        return root_;
+    }
+
+    static key_type const &get_key_(node_t *node)
+    {
+        return config_t::get_key(node->value);
+    }
+    static size_type size_(node_t *node)
+    {
+        return node == nullptr ? 0 : node->size;
+    }
+    node_t *find_node_(key_type const &key) const
+    {
+        node_t *node = root_.root, *candidate = nullptr;
+        while(node != nullptr)
+        {
+            if(get_comparator_()(get_key_(node), key))
+            {
+                node = node->right;
+            }
+            else
+            {
+                candidate = node;
+                node = node->left;
+            }
+        }
+        return (candidate == nullptr || get_comparator_()(key, get_key_(candidate))) ? nullptr : candidate;
+    }
+    template<class ...args_t> node_t *create_node_(args_t &&...args)
+    {
+        node_t *node = get_node_allocator_().allocate(1);
+        try
+        {
+            get_node_allocator_().construct(node, std::forward<args_t>(args)...);
+        }
+        catch(...)
+        {
+            get_node_allocator_().deallocate(node, 1);
+            throw;
+        }
+        return node;
+    }
+    void destroy_node_(node_t *node)
+    {
+        get_node_allocator_().destroy(node);
+        get_node_allocator_().deallocate(node, 1);
+    }
+
+    static node_t *acquire_(node_t *node)
+    {
+        if(node != nullptr)
+        {
+            ++node->ref;
+        }
+        return node;
+    }
+    void release_(node_t *node)
+    {
+        while(node != nullptr && --node->ref == 0)
+        {
+            node_t *right = node->right;
+            release_(node->left);
+            destroy_node_(node);
+            node = right;
+        }
+    }
+
+    //a node only this version reaches is changed in place, a shared one is copied first and the copy takes its place
+    //slot keeps a valid subtree if the copy throws
+    node_t *unshare_(node_t *&slot)
+    {
+        node_t *node = slot;
+        if(node->ref == 1)
+        {
+            return node;
+        }
+        node_t *copy = create_node_(node->value);
+        copy->left = acquire_(node->left);
+        copy->right = acquire_(node->right);
+        copy->size = node->size;
+        --node->ref;
+        return slot = copy;
+    }
+
+    template<class ...args_t> void insert_here_(args_t &&...args)
+    {
+        if(size() >= max_size() - 1)
+        {
+            throw std::length_error("sbtree too long");
+        }
+        node_t *leaf = create_node_(std::forward<args_t>(args)...);
+        bool is_linked = false;
+        try
+        {
+            if(unique_select_t::value && find_node_(get_key_(leaf)) != nullptr)
+            {
+                destroy_node_(leaf);
+                return;
+            }
+            insert_(root_.root, leaf, is_linked);
+        }
+        catch(...)
+        {
+            if(!is_linked)
+            {
+                destroy_node_(leaf);
+            }
+            throw;
+        }
+    }
+
+    //unshare_ on the way down or maintain_ on the way up may throw, the version being built is dropped then
+    //links and references stay right for release_ either way, leaf belongs to the tree once is_linked is set
+    void insert_(node_t *&slot, node_t *leaf, bool &is_linked)
+    {
+        if(slot == nullptr)
+        {
+            slot = leaf;
+            is_linked = true;
+            return;
+        }
+        node_t *node = unshare_(slot);
+        if(get_comparator_()(get_key_(leaf), get_key_(node)))
+        {
+            insert_(node->left, leaf, is_linked);
+            ++node->size;
+            maintain_<true>(slot);
+        }
+        else
+        {
+            insert_(node->right, leaf, is_linked);
+            ++node->size;
+            maintain_<false>(slot);
+        }
+    }
+
+    void erase_at_(node_t *&slot, size_type index)
+    {
+        node_t *node = unshare_(slot);
+        size_type left_size = size_(node->left);
+        if(index < left_size)
+        {
+            erase_at_(node->left, index);
+            --node->size;
+            maintain_<false>(slot);
+        }
+        else if(index > left_size)
+        {
+            erase_at_(node->right, index - left_size - 1);
+            --node->size;
+            maintain_<true>(slot);
+        }
+        else if(node->left == nullptr || node->right == nullptr)
+        {
+            slot = node->left == nullptr ? node->right : node->left;
+            node->left = node->right = nullptr;
+            destroy_node_(node);
+        }
+        else
+        {
+            node_t *min = nullptr;
+            try
+            {
+                erase_min_(node->right, min);
+            }
+            catch(...)
+            {
+                if(min != nullptr)
+                {
+                    destroy_node_(min);
+                }
+                throw;
+            }
+            min->left = node->left;
+            min->right = node->right;
+            min->size = node->size - 1;
+            node->left = node->right = nullptr;
+            slot = min;
+            destroy_node_(node);
+            maintain_<true>(slot);
+        }
+    }
+
+    //detach the smallest node of slot into min, unshared, children cleared
+    //min is set before any maintain_ runs, so the caller still owns it when one throws
+    void erase_min_(node_t *&slot, node_t *&min)
+    {
+        node_t *node = unshare_(slot);
+        if(node->left == nullptr)
+        {
+            slot = node->right;
+            node->right = nullptr;
+            min = node;
+            return;
+        }
+        erase_min_(node->left, min);
+        --node->size;
+        maintain_<false>(slot);
+    }
+
+    template<bool is_left> static node_t *&child_(node_t *node)
+    {
+        return is_left ? node->left : node->right;
+    }
+
+    //node goes down to the is_left side, its other child comes up
+    template<bool is_left> void rotate_(node_t *&slot)
+    {
+        node_t *node = slot;
+        node_t *child = unshare_(child_<!is_left>(node));
+        child_<!is_left>(node) = child_<is_left>(child);
+        child_<is_left>(child) = node;
+        child->size = node->size;
+        node->size = size_(node->left) + size_(node->right) + 1;
+        slot = child;
+    }
+
+    //is_left side grew or the other side shrank, the classic recursive maintain, only rotated nodes are unshared
+    template<bool is_left> void maintain_(node_t *&slot)
+    {
+        node_t *node = slot;
+        node_t *child = child_<is_left>(node);
+        if(child == nullptr)
+        {
+            return;
+        }
+        size_type other_size = size_(child_<!is_left>(node));
+        if(size_(child_<is_left>(child)) > other_size)
+        {
+            unshare_(slot);
+            rotate_<!is_left>(slot);
+        }
+        else if(size_(child_<!is_left>(child)) > other_size)
+        {
+            node = unshare_(slot);
+            unshare_(child_<is_left>(node));
+            rotate_<is_left>(child_<is_left>(node));
+            rotate_<!is_left>(slot);
+        }
+        else
+        {
+            return;
+        }
+        maintain_<true>(slot->left);
+        maintain_<false>(slot->right);
+        maintain_<true>(slot);
+        maintain_<false>(slot);
+    }
+};
+
+template<class key_t, class value_t, class comparator_t = std::less<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using sbtree_persistent_map = persistent_size_balanced_tree<sbtree_map_config_t<key_t, value_t, std::true_type, comparator_t, allocator_t>>;
+template<class key_t, class value_t, class comparator_t = std::less<key_t>, class allocator_t = std::allocator<std::pair<key_t const, value_t>>>
+using sbtree_persistent_multimap = persistent_size_balanced_tree<sbtree_multimap_config_t<key_t, value_t, comparator_t, allocator_t>>;
+template<class value_t, class comparator_t = std::less<value_t>, class allocator_t = std::allocator<value_t>>
+using sbtree_persistent_set = persistent_size_balanced_tree<sbtree_set_config_t<value_t, std::true_type, comparator_t, allocator_t>>;
+template<class value_t, class comparator_t = std::less<value_t>, class allocator_t = std::allocator<value_t>>
+using sbtree_persistent_multiset = persistent_size_balanced_tree<sbtree_multiset_config_t<value_t, comparator_t, allocator_t>>;
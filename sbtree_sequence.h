@@ -0,0 +1,265 @@
+#pragma once
+
+#include "sbtree.h"
+
+
+namespace sbtree_sequence_detail
+{
+    //positions are the keys, elements are never compared
+    struct no_compare_t
+    {
+        template<class value_t> bool operator()(value_t const &, value_t const &) const
+        {
+            return false;
+        }
+    };
+}
+
+template<class value_t, class allocator_t>
+struct sbtree_sequence_config_t
+{
+    typedef value_t key_type;
+    typedef value_t mapped_type;
+    typedef value_t value_type;
+    typedef sbtree_sequence_detail::no_compare_t key_compare;
+    typedef allocator_t allocator_type;
+    template<class in_type> static key_type const &get_key(in_type &&value)
+    {
+        return value;
+    }
+};
+
+//implicit key sequence (rope) on size_balanced_tree, O(log n) insert/erase/index anywhere
+//split_at/concat/cut/paste move whole subsequences in O(log n), nodes are relinked not copied
+template<class value_t, class allocator_t = std::allocator<value_t>>
+class sbtree_sequence : protected size_balanced_tree<sbtree_sequence_config_t<value_t, allocator_t>>
+{
+protected:
+    typedef size_balanced_tree<sbtree_sequence_config_t<value_t, allocator_t>> base_t;
+    typedef typename base_t::node_t node_t;
+
+public:
+    typedef typename base_t::value_type value_type;
+    typedef typename base_t::size_type size_type;
+    typedef typename base_t::difference_type difference_type;
+    typedef typename base_t::allocator_type allocator_type;
+    typedef typename base_t::reference reference;
+    typedef typename base_t::const_reference const_reference;
+    typedef typename base_t::pointer pointer;
+    typedef typename base_t::const_pointer const_pointer;
+    typedef typename base_t::iterator iterator;
+    typedef typename base_t::const_iterator const_iterator;
+    typedef typename base_t::reverse_iterator reverse_iterator;
+    typedef typename base_t::const_reverse_iterator const_reverse_iterator;
+
+public:
+    //empty
+    sbtree_sequence() : base_t()
+    {
+    }
+    //empty
+    explicit sbtree_sequence(allocator_type const &alloc) : base_t(alloc)
+    {
+    }
+    //count copies of value
+    sbtree_sequence(size_type count, value_type const &value, allocator_type const &alloc = allocator_type()) : base_t(alloc)
+    {
+        for(size_type i = 0; i < count; ++i)
+        {
+            emplace_back(value);
+        }
+    }
+    //range, built balanced in O(n)
+    template<class iterator_t, class = typename std::iterator_traits<iterator_t>::iterator_category> sbtree_sequence(iterator_t begin, iterator_t end, allocator_type const &alloc = allocator_type()) : base_t(begin, end, typename base_t::key_compare(), alloc)
+    {
+    }
+    //initializer list
+    sbtree_sequence(std::initializer_list<value_type> il, allocator_type const &alloc = allocator_type()) : base_t(il.begin(), il.end(), typename base_t::key_compare(), alloc)
+    {
+    }
+    sbtree_sequence(sbtree_sequence const &) = default;
+    sbtree_sequence(sbtree_sequence &&) = default;
+    sbtree_sequence &operator = (sbtree_sequence const &) = default;
+    sbtree_sequence &operator = (sbtree_sequence &&) = default;
+
+    using base_t::get_allocator;
+    using base_t::begin;
+    using base_t::end;
+    using base_t::cbegin;
+    using base_t::cend;
+    using base_t::rbegin;
+    using base_t::rend;
+    using base_t::crbegin;
+    using base_t::crend;
+    using base_t::front;
+    using base_t::back;
+    using base_t::empty;
+    using base_t::size;
+    using base_t::max_size;
+    using base_t::clear;
+
+    //index of where, end gives size
+    static size_type rank(const_iterator where)
+    {
+        return base_t::rank(where);
+    }
+
+    void swap(sbtree_sequence &other)
+    {
+        base_t::swap(other);
+    }
+
+    //if(index >= size) return end
+    iterator nth(size_type index)
+    {
+        return base_t::at(index);
+    }
+    //if(index >= size) return end
+    const_iterator nth(size_type index) const
+    {
+        return base_t::at(index);
+    }
+    reference operator[](size_type index)
+    {
+        return *base_t::at(index);
+    }
+    const_reference operator[](size_type index) const
+    {
+        return *base_t::at(index);
+    }
+    reference at(size_type index)
+    {
+        if(index >= size())
+        {
+            throw std::out_of_range("sbtree_sequence out of range");
+        }
+        return *base_t::at(index);
+    }
+    const_reference at(size_type index) const
+    {
+        if(index >= size())
+        {
+            throw std::out_of_range("sbtree_sequence out of range");
+        }
+        return *base_t::at(index);
+    }
+
+    //insert before where
+    template<class ...args_t> iterator emplace(const_iterator where, args_t &&...args)
+    {
+        base_t::check_max_size_();
+        node_t *node = base_t::sbt_create_node_(std::forward<args_t>(args)...);
+        base_t::sbt_insert_before_(base_t::get_node_(where), node);
+        return iterator(node);
+    }
+    iterator insert(const_iterator where, value_type const &value)
+    {
+        return emplace(where, value);
+    }
+    iterator insert(const_iterator where, value_type &&value)
+    {
+        return emplace(where, std::move(value));
+    }
+    //range is built balanced then pasted, O(k + log n), return first inserted or where
+    template<class iterator_t, class = typename std::iterator_traits<iterator_t>::iterator_category> iterator insert(const_iterator where, iterator_t begin, iterator_t end)
+    {
+        sbtree_sequence other(begin, end, get_allocator());
+        return paste(where, other);
+    }
+    iterator insert(const_iterator where, std::initializer_list<value_type> il)
+    {
+        return insert(where, il.begin(), il.end());
+    }
+    template<class ...args_t> reference emplace_back(args_t &&...args)
+    {
+        return *emplace(cend(), std::forward<args_t>(args)...);
+    }
+    template<class ...args_t> reference emplace_front(args_t &&...args)
+    {
+        return *emplace(cbegin(), std::forward<args_t>(args)...);
+    }
+    void push_back(value_type const &value)
+    {
+        emplace(cend(), value);
+    }
+    void push_back(value_type &&value)
+    {
+        emplace(cend(), std::move(value));
+    }
+    void push_front(value_type const &value)
+    {
+        emplace(cbegin(), value);
+    }
+    void push_front(value_type &&value)
+    {
+        emplace(cbegin(), std::move(value));
+    }
+    void pop_back()
+    {
+        base_t::erase(std::prev(cend()));
+    }
+    void pop_front()
+    {
+        base_t::erase(cbegin());
+    }
+
+    iterator erase(const_iterator where)
+    {
+        return base_t::erase(where);
+    }
+    //O(log n + k)
+    iterator erase(const_iterator erase_begin, const_iterator erase_end)
+    {
+        return base_t::erase(erase_begin, erase_end);
+    }
+
+    //elements from index on move to the returned sequence
+    sbtree_sequence split_at(size_type index)
+    {
+        return sbtree_sequence(base_t::split_at(index));
+    }
+    //append all of other, other becomes empty
+    void concat(sbtree_sequence &other)
+    {
+        base_t::concat(other);
+    }
+    void concat(sbtree_sequence &&other)
+    {
+        base_t::concat(other);
+    }
+    //move [cut_begin, cut_end) out to the returned sequence
+    sbtree_sequence cut(const_iterator cut_begin, const_iterator cut_end)
+    {
+        size_type index_begin = rank(cut_begin), index_end = rank(cut_end);
+        if(index_begin >= index_end)
+        {
+            return sbtree_sequence(get_allocator());
+        }
+        sbtree_sequence tail = split_at(index_end);
+        sbtree_sequence middle = split_at(index_begin);
+        concat(tail);
+        return middle;
+    }
+    //move all of other before where, other becomes empty, return first pasted or where
+    iterator paste(const_iterator where, sbtree_sequence &other)
+    {
+        if(other.empty())
+        {
+            return iterator(base_t::get_node_(where));
+        }
+        size_type index = rank(where);
+        sbtree_sequence tail = split_at(index);
+        concat(other);
+        concat(tail);
+        return base_t::at(index);
+    }
+    iterator paste(const_iterator where, sbtree_sequence &&other)
+    {
+        return paste(where, other);
+    }
+
+protected:
+    explicit sbtree_sequence(base_t &&other) : base_t(std::move(other))
+    {
+    }
+};
@@ -3,19 +3,26 @@
 #include "sbtree.h"
 
 
-template<class key_t, class comparator_t, class allocator_t>
-struct sbtree_multiset_config_t
+template<class key_t, class unique_t, class comparator_t, class allocator_t>
+struct sbtree_set_config_t
 {
     typedef key_t key_type;
     typedef key_t const mapped_type;
     typedef key_t const value_type;
     typedef comparator_t key_compare;
     typedef allocator_t allocator_type;
+    typedef unique_t unique_type;
     template<class in_type> static key_type const &get_key(in_type &&value)
     {
         return value;
     }
 };
+template<class key_t, class comparator_t, class allocator_t>
+struct sbtree_multiset_config_t : public sbtree_set_config_t<key_t, std::false_type, comparator_t, allocator_t>
+{
+};
 
+template<class value_t, class comparator_t = std::less<value_t>, class allocator_t = std::allocator<value_t>>
+using sbtree_set = size_balanced_tree<sbtree_set_config_t<value_t, std::true_type, comparator_t, allocator_t>>;
 template<class value_t, class comparator_t = std::less<value_t>, class allocator_t = std::allocator<value_t>>
 using sbtree_multiset = size_balanced_tree<sbtree_multiset_config_t<value_t, comparator_t, allocator_t>>;
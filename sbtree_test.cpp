@@ -3,6 +3,11 @@
 
 #include "sbtree_map.h"
 #include "sbtree_set.h"
+#include "sbtree_sequence.h"
+#include "pool_allocator.h"
+#include "sbtree_augment.h"
+#include "sbtree_persistent.h"
+#include "eytzinger_tree.h"
 
 #include <chrono>
 #include <iostream>
@@ -10,10 +15,30 @@
 #include <map>
 #include <set>
 #include <cstring>
+#include <thread>
 
 
 #define assert(exp) assert_proc(exp, #exp, __FILE__, __LINE__)
 
+//copy throws when countdown reaches 0, the exception paths of sbtree_persistent
+struct copy_throw
+{
+    static int countdown;
+    int value;
+    copy_throw(int v) : value(v)
+    {
+    }
+    copy_throw(copy_throw const &other) : value(other.value)
+    {
+        if(countdown > 0 && --countdown == 0)
+        {
+            throw std::runtime_error("copy_throw");
+        }
+    }
+    copy_throw &operator = (copy_throw const &) = default;
+};
+int copy_throw::countdown = 0;
+
 auto assert_proc = [](bool no_error, char const *query, char const *file, size_t line)
 {
     if(!no_error)
@@ -122,6 +147,202 @@ public:
     }
 };
 
+//sizes, links, balance and depth shared by the tree test classes, access_t reads the nodes of one tree type
+//size balance: no nephew is larger than its uncle, weight balance (top_down_type): 2 * w(child) <= 5 * w(sibling), w = size + 1
+template<class access_t>
+class tree_checker
+{
+public:
+    template<class node_t> static bool check(node_t *root, node_t *parent, bool is_weight)
+    {
+        size_t max_depth = 0;
+        if(!check(root, parent, 1, max_depth, is_weight))
+        {
+            return false;
+        }
+        double count = double(access_t::size(root)) + 1;
+        return double(max_depth) <= (is_weight ? std::log(count) / std::log(7.0 / 5.0) : 2 * std::log2(count)) + 1;
+    }
+protected:
+    template<class node_t> static bool check(node_t *node, node_t *parent, size_t depth, size_t &max_depth, bool is_weight)
+    {
+        if(access_t::is_nil(node))
+        {
+            return true;
+        }
+        max_depth = std::max(max_depth, depth);
+        node_t *left = access_t::left(node), *right = access_t::right(node);
+        size_t left_size = access_t::size(left), right_size = access_t::size(right);
+        if(!access_t::is_linked(node, parent) || access_t::size(node) != left_size + right_size + 1)
+        {
+            return false;
+        }
+        if(is_weight ? 2 * (left_size + 1) > 5 * (right_size + 1) || 2 * (right_size + 1) > 5 * (left_size + 1) : !is_size_balanced(left, right_size) || !is_size_balanced(right, left_size))
+        {
+            return false;
+        }
+        return check(left, node, depth + 1, max_depth, is_weight) && check(right, node, depth + 1, max_depth, is_weight);
+    }
+    template<class node_t> static bool is_size_balanced(node_t *child, size_t uncle_size)
+    {
+        return access_t::is_nil(child) || (access_t::size(access_t::left(child)) <= uncle_size && access_t::size(access_t::right(child)) <= uncle_size);
+    }
+};
+
+//node access of size_balanced_tree and the containers on it, never constructed
+template<class b_t>
+struct sbtree_access : public b_t
+{
+    typedef typename b_t::node_t node_t;
+    static bool is_nil(node_t *node)
+    {
+        return b_t::is_nil_(node);
+    }
+    static node_t *left(node_t *node)
+    {
+        return b_t::get_left_(node);
+    }
+    static node_t *right(node_t *node)
+    {
+        return b_t::get_right_(node);
+    }
+    static size_t size(node_t *node)
+    {
+        return b_t::get_size_(node);
+    }
+    static bool is_linked(node_t *node, node_t *parent)
+    {
+        return b_t::get_parent_(node) == parent;
+    }
+    //tree, most left, most right
+    static bool check(node_t *root, node_t *head, node_t *most_left, node_t *most_right, bool is_weight)
+    {
+        if(!tree_checker<sbtree_access>::check(root, head, is_weight))
+        {
+            return false;
+        }
+        return b_t::is_nil_(root) || (most_left == b_t::template bst_most_<true>(root) && most_right == b_t::template bst_most_<false>(root));
+    }
+};
+
+template<class key_t, class value_t>
+class sbtree_map_test : public sbtree_map<key_t, value_t>
+{
+protected:
+    typedef sbtree_map<key_t, value_t> b_t;
+
+public:
+    using b_t::b_t;
+    bool check()
+    {
+        return sbtree_access<b_t>::check(b_t::get_root_(), b_t::nil_(), b_t::get_most_left_(), b_t::get_most_right_(), false);
+    }
+};
+
+template<class key_t, class value_t>
+class sbtree_persistent_test : public sbtree_persistent_multimap<key_t, value_t>
+{
+protected:
+    typedef sbtree_persistent_multimap<key_t, value_t> b_t;
+    typedef typename b_t::node_t node_t;
+
+    //nullptr leaves, no parent links, every reachable node is referenced
+    struct access
+    {
+        static bool is_nil(node_t *node)
+        {
+            return node == nullptr;
+        }
+        static node_t *left(node_t *node)
+        {
+            return node->left;
+        }
+        static node_t *right(node_t *node)
+        {
+            return node->right;
+        }
+        static size_t size(node_t *node)
+        {
+            return b_t::size_(node);
+        }
+        static bool is_linked(node_t *node, node_t *)
+        {
+            return node->ref != 0;
+        }
+    };
+public:
+    sbtree_persistent_test()
+    {
+    }
+    sbtree_persistent_test(b_t const &other) : b_t(other)
+    {
+    }
+    bool check()
+    {
+        return tree_checker<access>::check(b_t::root_.root, static_cast<node_t *>(nullptr), false);
+    }
+    //nodes both versions reach through the same pointer
+    size_t shared(sbtree_persistent_test const &other) const
+    {
+        std::set<typename b_t::node_t const *> mine;
+        collect(b_t::root_.root, mine);
+        std::set<typename b_t::node_t const *> theirs;
+        collect(other.root_.root, theirs);
+        size_t count = 0;
+        for(auto node : theirs)
+        {
+            count += mine.count(node);
+        }
+        return count;
+    }
+    static void collect(typename b_t::node_t const *node, std::set<typename b_t::node_t const *> &all)
+    {
+        if(node != nullptr)
+        {
+            all.emplace(node);
+            collect(node->left, all);
+            collect(node->right, all);
+        }
+    }
+};
+
+template<class base_config_t>
+struct sbtree_top_down_config_t : public base_config_t
+{
+    typedef std::true_type top_down_type;
+};
+
+template<class base_config_t>
+class sbtree_top_down_test : public size_balanced_tree<sbtree_top_down_config_t<base_config_t>>
+{
+protected:
+    typedef size_balanced_tree<sbtree_top_down_config_t<base_config_t>> b_t;
+
+public:
+    using b_t::b_t;
+    bool check()
+    {
+        return sbtree_access<b_t>::check(b_t::get_root_(), b_t::nil_(), b_t::get_most_left_(), b_t::get_most_right_(), true);
+    }
+};
+
+template<class value_t>
+class sbtree_seq_test : public sbtree_sequence<value_t>
+{
+protected:
+    typedef sbtree_sequence<value_t> s_t;
+
+public:
+    using s_t::s_t;
+    sbtree_seq_test(s_t &&other) : s_t(std::move(other))
+    {
+    }
+    bool check()
+    {
+        return sbtree_access<s_t>::check(s_t::get_root_(), s_t::nil_(), s_t::get_most_left_(), s_t::get_most_right_(), false);
+    }
+};
+
 struct test_comp
 {
     bool is_less = 0;
@@ -346,6 +567,7 @@ int main()
         assert(rit.base() == sb1.begin());
         assert(rit == sb1.rend());
         assert(sb2.rbegin() + 10 == sb2.rend() - 190);
+        assert(sb2.rend() - sb2.rbegin() == 200 && sb2.rbegin() < sb2.rend() && sb2.rend() - (sb2.rbegin() + 10) == 190);
         assert(sb.at(100)->second == sb.at(50)[50].second);
         assert(sb.at(74) < sb.at(75));
         assert(sb.at(75) >= sb.at(75));
@@ -485,6 +707,649 @@ int main()
         rb.clear();
     }();
 
+    [&]()
+    {
+        typedef sbtree_multiset<int, std::less<int>, pool_allocator<int>> pool_set_t;
+        pool_set_t ps;
+        std::multiset<int> rs;
+        for(int i = 0; i < 20000; ++i)
+        {
+            int r = rand() % 1000;
+            if(r < 600 || ps.empty())
+            {
+                ps.emplace(r);
+                rs.emplace(r);
+            }
+            else
+            {
+                auto where = ps.at(rand() % ps.size());
+                rs.erase(rs.find(*where));
+                ps.erase(where);
+            }
+        }
+        assert(ps.size() == rs.size() && std::equal(ps.begin(), ps.end(), rs.begin()));
+        pool_set_t copy = ps;
+        assert(copy.get_allocator() != ps.get_allocator());
+        pool_set_t other(ps.begin(), ps.end(), std::less<int>(), ps.get_allocator());
+        assert(other.get_allocator() == ps.get_allocator());
+        ps.clear();
+        assert(std::equal(copy.begin(), copy.end(), rs.begin()) && std::equal(other.begin(), other.end(), rs.begin()));
+        other = copy;
+        assert(other.get_allocator() == ps.get_allocator() && std::equal(other.begin(), other.end(), rs.begin()));
+        copy = std::move(other);
+        other.swap(ps);
+        assert(other.empty() && copy.size() == rs.size());
+        std::vector<pool_set_t> shared(4, copy);
+        std::vector<std::thread> threads;
+        for(auto &tree : shared)
+        {
+            threads.emplace_back([&tree]
+            {
+                for(int i = 0; i < 20000; ++i)
+                {
+                    tree.emplace(i % 1000);
+                    tree.erase(tree.begin());
+                }
+            });
+        }
+        for(auto &thread : threads)
+        {
+            thread.join();
+        }
+        for(auto &tree : shared)
+        {
+            assert(tree.size() == rs.size() && tree.get_allocator() != copy.get_allocator());
+        }
+        sbtree_multimap<int, std::string, std::less<int>, pool_allocator<std::pair<int const, std::string>, 64>> pm;
+        for(int i = 0; i < 1000; ++i)
+        {
+            pm.emplace(i % 10, std::to_string(i));
+        }
+        assert(pm.count(3) == 100 && pm.find(9)->second == "9");
+    }();
+
+    [&]()
+    {
+        std::vector<std::pair<int, int>> sorted, shuffled;
+        for(int i = 0; i < 10000; ++i)
+        {
+            sorted.emplace_back(i / 3, i);
+        }
+        shuffled = sorted;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+        sbtree_mmap_test<int, int> built, inserted;
+        built.insert(sorted.begin(), sorted.end());
+        inserted.insert(shuffled.begin(), shuffled.end());
+        assert(built.check() && inserted.check());
+        assert(built.size() == sorted.size() && inserted.size() == sorted.size());
+        assert(std::equal(built.begin(), built.end(), sorted.begin(), [](std::pair<int const, int> const &l, std::pair<int, int> const &r){ return l.first == r.first && l.second == r.second; }));
+        assert(built.front().second == 0 && built.back().second == 9999 && built.at(5000)->second == 5000);
+        assert(built.rank(1000) == 3000 && built.count(1000) == 3);
+        for(int i = 0; i < 2000; ++i)
+        {
+            built.emplace(rand() % 4000, -1);
+            built.erase(built.at(rand() % built.size()));
+        }
+        assert(built.check() && built.size() == sorted.size());
+        sbtree_multiset<int> il = {1, 2, 2, 3, 5, 8};
+        sbtree_multiset<int> un = {8, 5, 3, 2, 2, 1};
+        assert(std::equal(il.begin(), il.end(), un.begin()) && il.size() == 6);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(7);
+        std::vector<int> ref;
+        sbtree_seq_test<int> seq;
+        int next = 0;
+        for(int i = 0; i < 3000; ++i)
+        {
+            int r = mt() % 100;
+            if(r < 40 || ref.empty())
+            {
+                size_t where = mt() % (ref.size() + 1);
+                seq.insert(seq.nth(where), next);
+                ref.insert(ref.begin() + where, next++);
+            }
+            else if(r < 55)
+            {
+                size_t where = mt() % ref.size();
+                seq.erase(seq.nth(where));
+                ref.erase(ref.begin() + where);
+            }
+            else if(r < 75)
+            {
+                size_t b = mt() % (ref.size() + 1), e = mt() % (ref.size() + 1), w;
+                if(b > e)
+                {
+                    std::swap(b, e);
+                }
+                sbtree_seq_test<int> block = seq.cut(seq.nth(b), seq.nth(e));
+                assert(block.check() && block.size() == e - b);
+                std::vector<int> ref_block(ref.begin() + b, ref.begin() + e);
+                ref.erase(ref.begin() + b, ref.begin() + e);
+                w = mt() % (ref.size() + 1);
+                seq.paste(seq.nth(w), block);
+                ref.insert(ref.begin() + w, ref_block.begin(), ref_block.end());
+                assert(block.empty());
+            }
+            else if(r < 85)
+            {
+                size_t where = mt() % (ref.size() + 1);
+                std::vector<int> items(mt() % 50);
+                for(auto &item : items)
+                {
+                    item = next++;
+                }
+                seq.insert(seq.nth(where), items.begin(), items.end());
+                ref.insert(ref.begin() + where, items.begin(), items.end());
+            }
+            else if(r < 90)
+            {
+                size_t b = mt() % (ref.size() + 1), e = std::min(ref.size(), b + mt() % 100);
+                seq.erase(seq.nth(b), seq.nth(e));
+                ref.erase(ref.begin() + b, ref.begin() + e);
+            }
+            else
+            {
+                size_t where = mt() % (ref.size() + 1);
+                sbtree_seq_test<int> tail = seq.split_at(where);
+                assert(seq.check() && tail.check() && seq.size() == where && tail.size() == ref.size() - where);
+                seq.concat(tail);
+            }
+            assert(seq.check() && seq.size() == ref.size());
+        }
+        assert(std::equal(seq.begin(), seq.end(), ref.begin(), ref.end()));
+        for(size_t i = 0; i < ref.size(); i += 7)
+        {
+            assert(seq[i] == ref[i] && seq.rank(seq.nth(i)) == i);
+        }
+        seq.push_front(-1);
+        seq.push_back(-2);
+        assert(seq.front() == -1 && seq.back() == -2 && seq.at(seq.size() - 1) == -2);
+        seq.pop_front();
+        seq.pop_back();
+        try
+        {
+            seq.at(seq.size());
+            assert(false);
+        }
+        catch(std::out_of_range const &)
+        {
+        }
+
+        sbtree_multiset<int> a = {1, 2, 3, 4, 5, 6, 7, 8, 9}, b = {9, 10, 11};
+        sbtree_multiset<int> c = a.split_at(4);
+        assert(a.size() == 4 && c.size() == 5 && *c.begin() == 5 && a.back() == 4 && c.find(7) != c.end() && a.find(7) == a.end());
+        a.concat(c);
+        a.concat(b);
+        assert(a.size() == 12 && b.empty() && c.empty() && a.count(9) == 2 && a.rank(10) == 10);
+        a.emplace(0);
+        assert(*a.begin() == 0 && a.back() == 11);
+
+        sbtree_multiset<int> same = {5, 5, 5};
+        assert(same.erase(5) == 3 && same.begin() == same.end() && same.empty());
+        same.emplace(6);
+        assert(*same.begin() == 6 && same.back() == 6 && same.size() == 1);
+        seq.erase(seq.begin(), seq.end());
+        assert(seq.check() && seq.begin() == seq.end() && seq.empty());
+        seq.push_back(3);
+        seq.push_back(4);
+        seq.push_front(2);
+        assert(seq.check() && seq.size() == 3 && seq.front() == 2 && seq.back() == 4);
+        seq.clear();
+        assert(seq.begin() == seq.end());
+        seq.push_back(7);
+        assert(seq.front() == 7 && seq.back() == 7);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(11);
+        sbtree_mmap_test<int, int> sb;
+        std::multimap<int, int> rb;
+        for(int i = 0; i < 20000; ++i)
+        {
+            int key = mt() % 5000;
+            sb.emplace(key, i);
+            rb.emplace(key, i);
+        }
+        while(rb.size() > 100)
+        {
+            size_t b = mt() % rb.size(), e = std::min(rb.size(), b + mt() % 2000);
+            auto it = sb.erase(sb.begin() + b, sb.begin() + e);
+            auto rit = rb.erase(std::next(rb.begin(), b), std::next(rb.begin(), e));
+            assert(sb.check() && sb.size() == rb.size());
+            assert(it == sb.begin() + b && (rit == rb.end() || (it->first == rit->first && it->second == rit->second)));
+            int key = mt() % 5000;
+            assert(sb.erase(key) == rb.erase(key) && sb.check());
+        }
+        assert(std::equal(sb.begin(), sb.end(), rb.begin()));
+        sb.emplace(-1, 0);
+        assert(sb.erase(sb.begin() + 1, sb.end()) == sb.end() && sb.size() == 1 && sb.begin()->first == -1);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(12);
+        sbtree_interval_multimap<int> iv;
+        std::multimap<int, int> rb;
+        auto check = [&]()
+        {
+            int max_end = std::numeric_limits<int>::lowest();
+            for(auto &value : rb)
+            {
+                max_end = std::max(max_end, value.second);
+            }
+            assert(iv.size() == rb.size() && iv.aggregate() == max_end);
+            for(int i = 0; i < 20; ++i)
+            {
+                int point = mt() % 11000;
+                std::vector<std::pair<int, int>> found, expect;
+                sbtree_stab(iv, point, [&](std::pair<int const, int> const &value)
+                {
+                    found.emplace_back(value);
+                });
+                for(auto &value : rb)
+                {
+                    if(value.first <= point && point < value.second)
+                    {
+                        expect.emplace_back(value);
+                    }
+                }
+                assert(found == expect);
+                size_t b = mt() % (rb.size() + 1), e = std::min(rb.size(), b + mt() % 500);
+                int range_max = std::numeric_limits<int>::lowest();
+                for(auto it = std::next(rb.begin(), b); it != std::next(rb.begin(), e); ++it)
+                {
+                    range_max = std::max(range_max, it->second);
+                }
+                assert(iv.aggregate(iv.begin() + b, iv.begin() + e) == range_max);
+            }
+        };
+        for(int i = 0; i < 3000; ++i)
+        {
+            int begin = mt() % 10000, end = begin + 1 + mt() % 200;
+            if(i % 3 == 0)
+            {
+                iv.emplace_hint(iv.lower_bound(begin), begin, end);
+                rb.emplace_hint(rb.lower_bound(begin), begin, end);
+            }
+            else
+            {
+                iv.emplace(begin, end);
+                rb.emplace(begin, end);
+            }
+        }
+        check();
+        for(int i = 0; i < 30; ++i)
+        {
+            size_t where = mt() % rb.size();
+            iv.erase(iv.begin() + where);
+            rb.erase(std::next(rb.begin(), where));
+            int key = mt() % 10000;
+            assert(iv.erase(key) == rb.erase(key));
+            size_t b = mt() % rb.size(), e = std::min(rb.size(), b + mt() % 100);
+            iv.erase(iv.begin() + b, iv.begin() + e);
+            rb.erase(std::next(rb.begin(), b), std::next(rb.begin(), e));
+            size_t rank = mt() % rb.size();
+            auto tail = iv.split_at(rank);
+            assert(tail.aggregate(tail.begin(), tail.end()) == tail.aggregate());
+            iv.concat(tail);
+        }
+        check();
+        auto copy = iv;
+        assert(copy.aggregate() == iv.aggregate() && copy.aggregate(copy.begin() + 10, copy.end() - 10) == iv.aggregate(iv.begin() + 10, iv.end() - 10));
+
+        std::vector<std::pair<int, long long>> sorted;
+        for(int i = 0; i < 1000; ++i)
+        {
+            sorted.emplace_back(i / 3, i);
+        }
+        sbtree_augment_multimap<int, long long, sbtree_augment_sum<long long>> sum(sorted.begin(), sorted.end(), std::less<int>());
+        assert(sum.aggregate() == 999LL * 1000 / 2);
+        for(int key = 0; key < 334; key += 17)
+        {
+            long long prefix = 0;
+            for(auto &value : sorted)
+            {
+                prefix += value.first <= key ? value.second : 0;
+            }
+            assert(sum.aggregate(sum.begin(), sum.upper_bound(key)) == prefix);
+        }
+        assert(sum.aggregate(sum.end(), sum.begin()) == 0);
+        sbtree_augment_multiset<int, sbtree_augment_sum<int, sbtree_augment_detail::get_self_t>> key_sum = {5, 1, 4, 2, 3};
+        key_sum.erase(4);
+        assert(key_sum.aggregate() == 11 && key_sum.aggregate(key_sum.begin() + 1, key_sum.begin() + 3) == 5);
+        static_assert(std::is_const<std::remove_reference<decltype(*sum.begin())>::type>::value, "augment iterators are read only");
+        long long total = sum.aggregate(), prefix = sum.aggregate(sum.begin(), sum.begin() + 500);
+        sum.update(sum.begin() + 100, [](long long &value)
+        {
+            value += 1000;
+        });
+        sum.update(sum.end() - 1, [](long long &value)
+        {
+            value = 0;
+        });
+        assert(sum.aggregate() == total + 1000 - 999 && sum.aggregate(sum.begin(), sum.begin() + 500) == prefix + 1000);
+        assert(sum.begin()[100].second == 1100 && sum.back().second == 0);
+
+        sbtree_interval_multimap<int, std::greater<int>> down;
+        std::vector<std::pair<int, int>> up;
+        for(int i = 0; i < 2000; ++i)
+        {
+            int begin = mt() % 10000, end = begin + 1 + mt() % 200;
+            up.emplace_back(begin, end);
+            down.emplace(-begin, -end);
+        }
+        for(int i = 0; i < 50; ++i)
+        {
+            int point = mt() % 10300;
+            std::multiset<std::pair<int, int>> found, expect;
+            sbtree_stab(down, -point, [&](std::pair<int const, int> const &value)
+            {
+                found.emplace(-value.first, -value.second);
+            });
+            for(auto &value : up)
+            {
+                if(value.first <= point && point < value.second)
+                {
+                    expect.emplace(value);
+                }
+            }
+            assert(found == expect);
+        }
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(13);
+        sbtree_multiset<int> sb;
+        for(int i = 0; i < 10000; ++i)
+        {
+            sb.emplace(mt() % 3000);
+        }
+        std::vector<size_t> rank;
+        std::vector<int> key;
+        for(int i = 0; i < 500; ++i)
+        {
+            rank.emplace_back(mt() % (sb.size() + 10));
+            key.emplace_back(int(mt() % 3100) - 50);
+        }
+        std::sort(rank.begin(), rank.end());
+        std::sort(key.begin(), key.end());
+        std::vector<sbtree_multiset<int>::const_iterator> select;
+        std::vector<size_t> key_rank;
+        sbtree_multiset<int> const &csb = sb;
+        csb.select_batch(rank.begin(), rank.end(), std::back_inserter(select));
+        sb.rank_batch(key.begin(), key.end(), std::back_inserter(key_rank));
+        assert(select.size() == rank.size() && key_rank.size() == key.size());
+        for(size_t i = 0; i < rank.size(); ++i)
+        {
+            assert(select[i] == sb.at(rank[i]) && key_rank[i] == sb.rank(key[i]));
+        }
+        sbtree_multiset<int> empty;
+        std::vector<sbtree_multiset<int>::iterator> empty_select(1, sb.begin());
+        assert(empty.select_batch(rank.begin(), rank.begin() + 1, empty_select.begin()) == empty_select.end() && empty_select[0] == empty.end());
+        assert(empty.rank_batch(key.begin(), key.begin() + 1, key_rank.begin()) == key_rank.begin() + 1 && key_rank[0] == 0);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(14);
+        sbtree_map_test<int, int> sb;
+        std::map<int, int> rb;
+        for(int i = 0; i < 20000; ++i)
+        {
+            int key = mt() % 3000;
+            switch(i % 6)
+            {
+            case 0:
+                {
+                    auto result = sb.insert(std::make_pair(key, i));
+                    auto expect = rb.insert(std::make_pair(key, i));
+                    assert(result.second == expect.second && result.first->first == key && result.first->second == expect.first->second);
+                }
+                break;
+            case 1:
+                {
+                    auto result = sb.emplace(key, i);
+                    auto expect = rb.emplace(key, i);
+                    assert(result.second == expect.second && result.first->second == expect.first->second);
+                }
+                break;
+            case 2:
+                {
+                    auto result = sb.try_emplace(key, i);
+                    auto expect = rb.insert(std::make_pair(key, i));
+                    assert(result.second == expect.second && result.first->second == expect.first->second);
+                }
+                break;
+            case 3:
+                assert(sb.emplace_hint(sb.lower_bound(key), key, i)->second == rb.emplace_hint(rb.lower_bound(key), key, i)->second);
+                break;
+            case 4:
+                assert(sb.try_emplace(sb.upper_bound(key), key, i)->second == rb.emplace_hint(rb.upper_bound(key), key, i)->second);
+                break;
+            default:
+                sb[key] += i;
+                rb[key] += i;
+                break;
+            }
+            if(i % 97 == 0)
+            {
+                int erase_key = mt() % 3000;
+                assert(sb.erase(erase_key) == rb.erase(erase_key));
+            }
+            assert(sb.size() == rb.size());
+        }
+        assert(sb.check() && std::equal(sb.begin(), sb.end(), rb.begin()));
+
+        std::vector<int> sorted = {1, 1, 2, 3, 3, 3, 5, 8, 8}, unsorted = {5, 3, 8, 1, 3, 1, 2, 8, 3};
+        sbtree_set<int> a(sorted.begin(), sorted.end(), std::less<int>()), b(unsorted.begin(), unsorted.end(), std::less<int>());
+        assert(a.size() == 5 && std::equal(a.begin(), a.end(), b.begin(), b.end()));
+        assert(!a.insert(3).second && a.insert(4).second && *a.insert(4).first == 4 && a.count(4) == 1);
+        a = {7, 7, 6};
+        assert(a.size() == 2 && *a.begin() == 6);
+        sbtree_map<std::string, std::unique_ptr<int>> owner;
+        assert(owner.try_emplace("a", new int(1)).second);
+        std::unique_ptr<int> kept(new int(2));
+        assert(!owner.try_emplace("a", std::move(kept)).second && kept != nullptr && *owner["a"] == 1);
+        sbtree_set<std::string> names;
+        assert(names.insert("a literal longer than a short string").second && !names.insert("a literal longer than a short string").second && names.size() == 1);
+        sbtree_map<std::string, int> counts;
+        assert(counts.insert(std::make_pair("another literal longer than a short string", 1)).second && !counts.insert(std::make_pair("another literal longer than a short string", 2)).second && counts.begin()->second == 1);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(15);
+        std::vector<sbtree_persistent_test<int, int>> version(1);
+        std::vector<std::multimap<int, int>> expect(1);
+        for(int i = 0; i < 3000; ++i)
+        {
+            size_t from = i < 1000 ? version.size() - 1 : mt() % version.size();
+            sbtree_persistent_test<int, int> next = version[from];
+            std::multimap<int, int> rb = expect[from];
+            int key = mt() % 800;
+            if(mt() % 3 != 0)
+            {
+                next = next.emplace(key, i);
+                rb.emplace(key, i);
+            }
+            else
+            {
+                next = next.erase(key);
+                rb.erase(key);
+            }
+            if(i % 7 == 0 && !rb.empty())
+            {
+                size_t index = mt() % rb.size();
+                next = next.erase_at(index);
+                rb.erase(std::next(rb.begin(), index));
+            }
+            assert(next.check() && next.size() == rb.size());
+            version.emplace_back(next);
+            expect.emplace_back(std::move(rb));
+        }
+        for(size_t i = 0; i < version.size(); i += 13)
+        {
+            auto &sb = version[i];
+            auto &rb = expect[i];
+            assert(sb.check() && std::equal(sb.begin(), sb.end(), rb.begin(), rb.end()));
+            for(int key = 0; key < 800; key += 41)
+            {
+                assert(sb.count(key) == rb.count(key) && sb.rank(key) == size_t(std::distance(rb.begin(), rb.lower_bound(key))));
+                assert((sb.find(key) == sb.end()) == (rb.find(key) == rb.end()));
+                assert(sb.upper_bound(key) == sb.at(std::distance(rb.begin(), rb.upper_bound(key))));
+            }
+        }
+        sbtree_persistent_test<int, int> &last = version.back();
+        sbtree_persistent_test<int, int> next = last.emplace(-1, -1);
+        assert(next.size() == last.size() + 1 && last.find(-1) == last.end() && next.find(-1) != next.end());
+        assert(next.size() - next.shared(last) <= 2 * std::log2(double(next.size()) + 1) + 2);
+        sbtree_persistent_test<int, int> same = last.erase(-2);
+        assert(same.shared(last) == last.size());
+        sbtree_persistent_test<int, int> triple = last.emplace(-3, 0).emplace(-3, 1).emplace(-3, 2);
+        sbtree_persistent_test<int, int> erased = triple.erase(-3);
+        assert(triple.count(-3) == 3 && erased.count(-3) == 0 && erased.size() == last.size() && erased.check());
+
+        sbtree_persistent_set<int> set = {5, 3, 5, 1};
+        assert(set.size() == 3 && *set.at(1) == 3 && set.insert(3).size() == 3 && set.insert(4).size() == 4 && set.size() == 3);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(20);
+        typedef sbtree_persistent_multimap<int, copy_throw> tree_t;
+        tree_t base;
+        for(int i = 0; i < 300; ++i)
+        {
+            base = base.emplace(int(mt() % 1000), copy_throw(i));
+        }
+        std::vector<std::pair<int, int>> expect;
+        for(auto &value : base)
+        {
+            expect.emplace_back(value.first, value.second.value);
+        }
+        size_t thrown = 0;
+        for(int i = 0; i < 40000; ++i)
+        {
+            try
+            {
+                copy_throw::countdown = i % 30 + 1;
+                switch(i % 4)
+                {
+                case 0:
+                    base.erase_at(mt() % base.size());
+                    break;
+                case 1:
+                    tree_t(base.begin(), base.end());
+                    break;
+                default:
+                    base.emplace(int(mt() % 1000), copy_throw(-1));
+                    break;
+                }
+            }
+            catch(std::runtime_error const &)
+            {
+                ++thrown;
+            }
+        }
+        copy_throw::countdown = 0;
+        std::vector<std::pair<int, int>> after;
+        for(auto &value : base)
+        {
+            after.emplace_back(value.first, value.second.value);
+        }
+        assert(thrown > 0 && after == expect);
+    }();
+
+    [&]()
+    {
+        std::mt19937 mt(16);
+        for(size_t count : {0, 1, 2, 7, 8, 1000, 4095, 4097})
+        {
+            sbtree_multimap<int, int> sb;
+            for(size_t i = 0; i < count; ++i)
+            {
+                sb.emplace(int(mt() % (count + 1)), int(i));
+            }
+            auto frozen = freeze(sb);
+            assert(frozen.size() == sb.size() && std::equal(frozen.begin(), frozen.end(), sb.begin(), sb.end()));
+            for(int key = -1; key <= int(count) + 1; ++key)
+            {
+                assert(frozen.rank(key) == sb.rank(key) && frozen.upper_rank(key) == sb.upper_rank(key) && frozen.count(key) == sb.count(key));
+                assert(frozen.lower_bound(key) == frozen.at(sb.lower_rank(key)) && frozen.upper_bound(key) == frozen.at(sb.upper_rank(key)));
+                assert((frozen.find(key) == frozen.end()) == (sb.find(key) == sb.end()));
+            }
+            for(size_t i = 0; i < count; i += 3)
+            {
+                assert(frozen.at(i)->second == sb.at(i)->second && frozen.rank(frozen.at(i)) == i);
+            }
+            assert(frozen.at(count) == frozen.end());
+        }
+        sbtree_set<std::string> names = {"b", "c", "a"};
+        eytzinger_tree<sbtree_set_config_t<std::string, std::true_type, std::less<std::string>, std::allocator<std::string>>> frozen(names);
+        assert(frozen.rank("b") == 1 && *frozen.find("c") == "c" && frozen.find("d") == frozen.end());
+    }();
+
+    [&]()
+    {
+        typedef sbtree_multimap_config_t<int, int, std::less<int>, std::allocator<std::pair<int const, int>>> config_t;
+        std::mt19937 mt(17);
+        int const count = 4000;
+        std::vector<std::vector<int>> load(5);
+        for(int i = 0; i < count; ++i)
+        {
+            load[0].push_back(i);
+            load[1].push_back(count - i);
+            load[2].push_back(int(mt() % 100000));
+            load[3].push_back(i % 2 == 0 ? i : count - i);
+            load[4].push_back(int(mt() % 16));
+        }
+        for(auto &keys : load)
+        {
+            sbtree_top_down_test<config_t> sb;
+            std::multimap<int, int> rb;
+            for(int i = 0; i < count; ++i)
+            {
+                sb.emplace(keys[i], i);
+                rb.emplace(keys[i], i);
+            }
+            assert(sb.check() && std::equal(sb.begin(), sb.end(), rb.begin(), rb.end()));
+            for(int i = 0; i < count; i += 3)
+            {
+                assert(sb.erase(keys[i]) == rb.erase(keys[i]));
+            }
+            for(int i = 0; i < count; i += 2)
+            {
+                sb.emplace_hint(sb.lower_bound(keys[i]), keys[i], -i);
+                rb.emplace_hint(rb.lower_bound(keys[i]), keys[i], -i);
+                sb.emplace(keys[i] + 1, i);
+                rb.emplace(keys[i] + 1, i);
+            }
+            assert(sb.check() && std::equal(sb.begin(), sb.end(), rb.begin(), rb.end()));
+        }
+        sbtree_top_down_test<sbtree_augment_config_t<config_t, sbtree_augment_sum<long long>>> sum;
+        long long total = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            sum.emplace(load[i % 4][i], i);
+            total += i;
+        }
+        assert(sum.check() && sum.aggregate() == total);
+        for(size_t i = 0; i <= sum.size(); i += 97)
+        {
+            long long prefix = 0;
+            for(auto it = sum.begin(); it != sum.begin() + i; ++it)
+            {
+                prefix += it->second;
+            }
+            assert(sum.aggregate(sum.begin(), sum.begin() + i) == prefix);
+        }
+    }();
+
     auto t = std::chrono::high_resolution_clock::now;
     std::mt19937 mt;
     auto mtr = std::uniform_int_distribution<int>(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
@@ -564,6 +1429,39 @@ int main()
         << "rb time 3(ms) = " << std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(re3 - rs3).count() << std::endl
         ;
 
+    typedef sbtree_multimap_config_t<int, int, std::less<int>, std::allocator<std::pair<int const, int>>> bottom_up_config_t;
+    auto insert_time = [&t](auto &&c, std::vector<int> const &keys)
+    {
+        auto s = t();
+        for(int key : keys)
+        {
+            c.emplace(key, key);
+        }
+        auto e = t();
+        return std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(e - s).count();
+    };
+    std::vector<int> sorted_keys(1000000), reverse_keys(sorted_keys.size()), random_keys(sorted_keys.size());
+    for(int i = 0; i < int(sorted_keys.size()); ++i)
+    {
+        sorted_keys[i] = i;
+        reverse_keys[i] = int(sorted_keys.size()) - i;
+        random_keys[i] = mtr(mt);
+    }
+    float bs = insert_time(size_balanced_tree<bottom_up_config_t>(), sorted_keys);
+    float ts = insert_time(size_balanced_tree<sbtree_top_down_config_t<bottom_up_config_t>>(), sorted_keys);
+    float br = insert_time(size_balanced_tree<bottom_up_config_t>(), reverse_keys);
+    float tr = insert_time(size_balanced_tree<sbtree_top_down_config_t<bottom_up_config_t>>(), reverse_keys);
+    float bx = insert_time(size_balanced_tree<bottom_up_config_t>(), random_keys);
+    float tx = insert_time(size_balanced_tree<sbtree_top_down_config_t<bottom_up_config_t>>(), random_keys);
+    std::cout
+        << "bottom up sorted(ms) = " << bs << std::endl
+        << "top down sorted(ms) = " << ts << std::endl
+        << "bottom up reverse(ms) = " << br << std::endl
+        << "top down reverse(ms) = " << tr << std::endl
+        << "bottom up random(ms) = " << bx << std::endl
+        << "top down random(ms) = " << tx << std::endl
+        ;
+
     system("pause");
 
     //for(int i = 0; i < 20000000; ++i)
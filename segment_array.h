@@ -874,7 +874,7 @@ public:;
            assign(begin, end);
        }
        //copy
-       segment_array_implement(segment_array_implement const &other) : root_(other.get_node_allocator_())
+       segment_array_implement(segment_array_implement const &other) : root_(std::allocator_traits<node_allocator_t>::select_on_container_copy_construction(other.get_node_allocator_()))
        {
            assign(other.begin(), other.end());
        }
@@ -909,7 +909,7 @@ public:;
            {
                return *this;
            }
-           if(get_node_allocator_() != other.get_node_allocator_())
+           if(std::allocator_traits<node_allocator_t>::propagate_on_container_copy_assignment::value && get_node_allocator_() != other.get_node_allocator_())
            {
                clear();
                get_node_allocator_() = other.get_node_allocator_();